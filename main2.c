@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "physics.h"
 
 #define COLOR_BLACK 0x00000000
 #define COLOR_WHITE 0xFFFFFFFF
@@ -20,17 +21,8 @@
 #define COLOR_NAVY 0x000080FF
 #define COLOR_YELLOW 0xFFFF00FF
 #define COLOR_AQUA 0x00FFFFFF
-#define RADIUS 50
 #define INIT_XVEL 0
 #define INIT_YVEL 0
-#define GRAVITY 0.2
-#define INVERSE_FRICTION_COEFF 0.996
-#define X_DAMP_COEFF 0.95
-#define Y_DAMP_COEFF 0.8
-#define MIN_YVEL 1
-#define MIN_XVEL 1
-#define COEFF_OF_RESTITUTION 0.8
-#define PATH_TRACE_LENGTH 30
 #define TRAJECTORY_AVG_SIZE 2
 #define TRAJECTORY_CALCULATION_WEIGHT 200
 #define MOUSE_SENSITIVITY 0.4
@@ -38,35 +30,61 @@
 #define MAXIMUM_BALLS_IN_SIMULATION_ALLOWED 300
 #define getFPS(FPS) 1000/FPS
 #define SIMULATION_FPS 144
+#define SCENE_LAYOUT SCENE_LINE // starting layout when none is passed, see SceneLayout in physics.h
+#define SCENE_SEED 1 // pass another seed for a different scene, the same seed always rebuilds the same one
+#define EVENT_DRIVEN_ENGINE 0 // 1 to start with the event-driven engine, 'E' toggles it while running
+#define TEXTURE_TRAILS 0 // 1 to start with trails accumulated in a fading texture instead of drawn from stored paths, 'T' toggles it while running
+#define TRAIL_FADE_ALPHA 24 // how much of the trail texture fades to black every frame, out of 255
+#define TRAIL_FADE_FLOOR 1 // also taken off every channel each frame, the fade rounds channels up to 255 / (2 * TRAIL_FADE_ALPHA) back up so they'd never reach black
+#define DIRTY_RECTS 0 // 1 to start repainting only around moving balls, 'D' toggles it while running
+#define DIRTY_MAX_RECTS 64 // more separate regions than this and a full repaint is cheaper
+#define DIRTY_FULL_REDRAW_AT 0.4 // fraction of the screen, past this much dirty area a full repaint is cheaper
+#define QUALITY_GOVERNOR 1 // 1 to trade trails and circle detail for holding SIMULATION_FPS under load, 'G' toggles it while running
+#define GOVERNOR_SMOOTHING 0.1 // weight of the newest frame in the running average of frame cost
+#define GOVERNOR_DEGRADE_AT 0.85 // fraction of the frame budget above which quality drops
+#define GOVERNOR_RESTORE_AT 0.5 // fraction of the frame budget below which quality may come back
+#define GOVERNOR_COOLDOWN_FRAMES 8 // frames to wait after a drop before dropping again, so the average catches up
+#define GOVERNOR_RESTORE_FRAMES 120 // frames in a row under GOVERNOR_RESTORE_AT before one level comes back
 
 int WIDTH = 900, HEIGHT = 600;
 
 Uint32 COLORS[] = {COLOR_RED, COLOR_GREEN, COLOR_BLUE, COLOR_ORANGE, COLOR_PURPLE, COLOR_LIME, COLOR_FUCHSLA, COLOR_MAROON, COLOR_NAVY, COLOR_YELLOW, COLOR_AQUA, COLOR_WHITE};
 
-typedef struct Point {
-  double x;
-  double y;
-  struct Point* next;
-  struct Point* prev;
-} Point ;
-
-typedef struct Path {
-  Point* st;
-  Point* top;
-  int n_points;
-} Path;
-
-typedef struct Circle {
-  Point* coords;
-  double radius;
-  double xvel;
-  double yvel;
-  Uint32 color;
-  Path* path;
-  int isInteracted;
-} Circle;
-
-// BALL->COORDS WILL BE HEAD AND PATH WILL MAKE POINTS TRACING THESE HEAD POINTS TO MAKE PATH LINKED LIST 
+typedef struct QualitySettings {
+  int trailLength; // segments of each path to draw, 0 turns trails off
+  double trailMinSpeed; // balls slower than this (px/frame) get no trail
+  int circleStep; // 0 draws circles with Bresenham, otherwise filled with strips this many px tall
+} QualitySettings;
+
+// Cheapest last, the governor walks up and down this list one level at a time
+QualitySettings QUALITY_LEVELS[] = {
+  {PATH_TRACE_LENGTH, 0, 0},
+  {PATH_TRACE_LENGTH / 2, 0, 0},
+  {PATH_TRACE_LENGTH / 2, 0.5, 2},
+  {PATH_TRACE_LENGTH / 4, 1, 3},
+  {0, 0, 4},
+};
+
+typedef struct DirtyRenderer {
+  SDL_Texture* frame; // persistent copy of the last frame, only dirty parts get repainted into it
+  SDL_Rect* drawn; // what each ball (circle and trail) covered last frame
+  int* lastX; // pixel each ball was drawn at last frame
+  int* lastY;
+  int* stillFrames; // frames in a row the ball stayed on the same pixel
+  SDL_Rect* rects;
+  int n_rects;
+  int n;
+  int level; // quality level the frame was drawn at, a change repaints everything
+  int fullRedraw;
+} DirtyRenderer;
+
+typedef struct QualityGovernor {
+  double targetMs;
+  double avgMs; // running average of how long a frame took before sleeping
+  int level; // index into QUALITY_LEVELS
+  int cooldown;
+  int calmFrames;
+} QualityGovernor;
 
 void enterFullScreen(SDL_Window* window) {
   SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN_DESKTOP);
@@ -82,69 +100,6 @@ void setRendererDrawColor(SDL_Renderer* renderer, Uint32 color) {
   SDL_SetRenderDrawColor(renderer, r, g, b, a);
 }
 
-Point* createPoint(double x, double y) {
-  Point* pt = (Point*)malloc(sizeof(Point));
-  pt->x = x;
-  pt->y = y;
-  pt->next = NULL;
-  pt->prev = NULL;
-  return pt;
-}
-
-Path* createPath(int pathLen, Point* start) {
-  Point* pt = createPoint(start->x, start->y);
-  Path* path = (Path*)malloc(sizeof(Path));
-  path->st = pt;
-  path->top = pt;
-  path->n_points = 1;
-  return path;
-}
-
-// path linked list contains points from ball->coords itself, so no need to free them twice
-Circle* createBall(Point* start, int radius, double xvel, double yvel, Uint32 color) {
-  Circle* circle = (Circle*)malloc(sizeof(Circle));
-  circle->coords = start;
-  circle->radius = radius;
-  circle->xvel = xvel;
-  circle->yvel = yvel;
-  circle->color = color;
-  circle->path = createPath(PATH_TRACE_LENGTH, start);
-  circle->isInteracted = 0;
-  return circle;
-}
-
-Circle** createBalls(int n) {
-  Circle** balls = (Circle**)malloc(n * sizeof(Circle*));
-  for (int i = 0; i < n; i++) {
-    Point* st = createPoint((float)(i + 1) * ((float)WIDTH / (n + 1)), (float)WIDTH / 2);
-    balls[i] = createBall(st, RADIUS, 0, 0, COLORS[rand() % (sizeof(COLORS) / sizeof(Uint32))]);
-  }
-  return balls;
-}
-
-void nextPointIntoPath(Circle* ball) {
-  Point* pt = createPoint(ball->coords->x, ball->coords->y);
-
-  ball->path->top->next = pt;
-  pt->prev = ball->path->top;
-  ball->path->top = pt;
-  ball->path->n_points++;
-
-  if (ball->path->n_points > PATH_TRACE_LENGTH) {
-    Point* temp = ball->path->st;
-    ball->path->st = ball->path->st->next;
-    ball->path->st->prev = NULL;
-    free(temp);
-    ball->path->n_points--;
-  }
-
-  // printf("pt->y: %f\tpath->top->y: %f\n", pt->y, path->top->y);
-}
-
-void nextPointsIntoPaths(Circle** balls, int n) {
-  for (int i = 0; i < n; i++) nextPointIntoPath(balls[i]);
-}
-
 void printPath(Path* path) {
   Point* tr = path->st;
   int cnt = path->n_points;
@@ -155,28 +110,69 @@ void printPath(Path* path) {
   }
 }
 
-void drawPathForBall(SDL_Renderer* renderer, Circle* ball, int i) {
+int isTrailVisible(Circle* ball, QualitySettings* quality) {
+  if (!quality->trailLength) return 0;
+  return ball->xvel * ball->xvel + ball->yvel * ball->yvel >= quality->trailMinSpeed * quality->trailMinSpeed;
+}
+
+// Walks back from the newest point, so a shorter trailLength just stops early
+void drawPathForBall(SDL_Renderer* renderer, Circle* ball, int trailLength) {
   setRendererDrawColor(renderer, ball->color);
-  Point* tr = ball->path->st;
-  while (tr->next) {
-    SDL_RenderDrawLine(renderer, tr->x, tr->y, tr->next->x, tr->next->y);
-    tr = tr->next;
+  Point* tr = ball->path->top;
+  while (tr->prev && trailLength--) {
+    SDL_RenderDrawLine(renderer, tr->prev->x, tr->prev->y, tr->x, tr->y);
+    tr = tr->prev;
   }
 }
 
-void drawPaths(SDL_Renderer* renderer, Circle** balls, int n) {
-  for (int i = 0; i < n; i++) drawPathForBall(renderer, balls[i], i);
+void drawPaths(SDL_Renderer* renderer, Circle** balls, int n, QualitySettings* quality) {
+  for (int i = 0; i < n; i++) if (isTrailVisible(balls[i], quality)) drawPathForBall(renderer, balls[i], quality->trailLength);
 }
 
-void deletePath(Circle* ball) {
-  Point* tr = ball->path->st;
-  while (tr) {
-    Point* temp = tr;
-    // printf("%d\t%f\n", path->n_points--, temp->y);
-    tr = tr->next;
-    free(temp);
+// Subtracts the draw color from the target and leaves its alpha alone
+SDL_BlendMode trailFloorBlendMode() {
+  return SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE, SDL_BLENDOPERATION_REV_SUBTRACT, SDL_BLENDFACTOR_ZERO, SDL_BLENDFACTOR_ONE, SDL_BLENDOPERATION_ADD);
+}
+
+// NULL when the renderer can't draw into textures or subtract (the software renderer can't), callers stay with line trails then
+SDL_Texture* createTrailTexture(SDL_Renderer* renderer) {
+  if (!SDL_RenderTargetSupported(renderer) || SDL_SetRenderDrawBlendMode(renderer, trailFloorBlendMode()) != 0) return NULL;
+  SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+  SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, WIDTH, HEIGHT);
+  if (!texture) return NULL;
+
+  SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+  if (SDL_SetRenderTarget(renderer, texture) != 0) {
+    SDL_DestroyTexture(texture);
+    return NULL;
   }
-  free(ball->path);
+  setRendererDrawColor(renderer, COLOR_BLACK);
+  SDL_RenderClear(renderer);
+  SDL_SetRenderTarget(renderer, NULL);
+  return texture;
+}
+
+// Fade everything drawn so far with one translucent quad and add just the newest segment of every trail, the older segments live on in the texture
+// Copying the texture covers the whole screen, so no clear is needed before this
+void drawTrailTexture(SDL_Renderer* renderer, SDL_Texture* texture, Circle** balls, int n, QualitySettings* quality) {
+  SDL_SetRenderTarget(renderer, texture);
+  SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+  SDL_SetRenderDrawColor(renderer, 0, 0, 0, TRAIL_FADE_ALPHA);
+  SDL_RenderFillRect(renderer, NULL);
+  SDL_SetRenderDrawBlendMode(renderer, trailFloorBlendMode());
+  SDL_SetRenderDrawColor(renderer, TRAIL_FADE_FLOOR, TRAIL_FADE_FLOOR, TRAIL_FADE_FLOOR, 0);
+  SDL_RenderFillRect(renderer, NULL);
+  SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+
+  for (int i = 0; i < n; i++) {
+    Point* top = balls[i]->path->top;
+    if (!top->prev || !isTrailVisible(balls[i], quality)) continue;
+    setRendererDrawColor(renderer, balls[i]->color);
+    SDL_RenderDrawLine(renderer, top->prev->x, top->prev->y, top->x, top->y);
+  }
+
+  SDL_SetRenderTarget(renderer, NULL);
+  SDL_RenderCopy(renderer, texture, NULL, NULL);
 }
 
 void drawCircle(SDL_Renderer* renderer, Circle* circle) {
@@ -203,55 +199,192 @@ void drawCircle(SDL_Renderer* renderer, Circle* circle) {
   }
 }
 
-void drawBalls(SDL_Renderer* renderer, Circle** balls, int n) {
-  for (int i = 0; i < n; i++) drawCircle(renderer, balls[i]);
+// Cheaper fill for when frames run late, one rect per step px instead of ~3 lines per px of radius
+void drawCircleCoarse(SDL_Renderer* renderer, Circle* circle, int step) {
+  setRendererDrawColor(renderer, circle->color);
+
+  int radius = circle->radius;
+  for (int dy = -radius; dy < radius; dy += step) {
+    double mid = dy + step / 2.0; // half width taken at the middle of the strip so the outline stays centered
+    if (mid > radius) mid = radius;
+    int halfWidth = sqrt(radius * radius - mid * mid);
+    SDL_Rect strip = {circle->coords->x - halfWidth, circle->coords->y + dy, 2 * halfWidth + 1, step};
+    SDL_RenderFillRect(renderer, &strip);
+  }
+}
+
+void drawBall(SDL_Renderer* renderer, Circle* ball, QualitySettings* quality) {
+  if (quality->circleStep) drawCircleCoarse(renderer, ball, quality->circleStep);
+  else drawCircle(renderer, ball);
 }
 
-void deleteBall(Circle* ball) {
-  deletePath(ball);
-  // free(ball->coords); // Since ball->path->top is ball->coords themselves, double free()
-  free(ball);
+void drawBalls(SDL_Renderer* renderer, Circle** balls, int n, QualitySettings* quality) {
+  for (int i = 0; i < n; i++) drawBall(renderer, balls[i], quality);
+}
+
+void drawFullFrame(SDL_Renderer* renderer, Circle** balls, int n, QualitySettings* quality) {
+  setRendererDrawColor(renderer, COLOR_BLACK);
+  SDL_RenderClear(renderer);
+  drawPaths(renderer, balls, n, quality);
+  drawBalls(renderer, balls, n, quality);
+}
+
+// Coarse circles can spill a strip past the radius, so the margin grows with the strip height
+SDL_Rect ballBounds(Circle* ball, QualitySettings* quality) {
+  int margin = 1 + quality->circleStep;
+  SDL_Rect bounds = {(int)ball->coords->x - (int)ball->radius - margin, (int)ball->coords->y - (int)ball->radius - margin, 2 * ((int)ball->radius + margin) + 1, 2 * ((int)ball->radius + margin) + 1};
+  return bounds;
+}
+
+// Everything drawPathForBall() and drawBall() touch for this ball, one px of slack for the int truncation while drawing
+SDL_Rect drawnBounds(Circle* ball, QualitySettings* quality) {
+  SDL_Rect bounds = ballBounds(ball, quality);
+  if (!isTrailVisible(ball, quality)) return bounds;
+
+  int minX = bounds.x, minY = bounds.y, maxX = bounds.x + bounds.w, maxY = bounds.y + bounds.h;
+  Point* tr = ball->path->top;
+  for (int k = 0; tr && k <= quality->trailLength; k++, tr = tr->prev) {
+    if (tr->x - 1 < minX) minX = tr->x - 1;
+    if (tr->y - 1 < minY) minY = tr->y - 1;
+    if (tr->x + 2 > maxX) maxX = tr->x + 2;
+    if (tr->y + 2 > maxY) maxY = tr->y + 2;
+  }
+
+  SDL_Rect trail = {minX, minY, maxX - minX, maxY - minY};
+  return trail;
 }
 
-void deleteBalls(Circle** balls, int n) {
-  for (int i = 0; i < n; i++) deleteBall(balls[i]);
-  free(balls);
+// NULL when the renderer can't draw into textures, callers stay with full repaints then
+DirtyRenderer* createDirtyRenderer(SDL_Renderer* renderer, int n) {
+  if (!SDL_RenderTargetSupported(renderer)) return NULL;
+  SDL_Texture* frame = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, WIDTH, HEIGHT);
+  if (!frame) return NULL;
+  SDL_SetTextureBlendMode(frame, SDL_BLENDMODE_NONE);
+
+  DirtyRenderer* dirty = (DirtyRenderer*)malloc(sizeof(DirtyRenderer));
+  dirty->frame = frame;
+  dirty->drawn = (SDL_Rect*)calloc(n, sizeof(SDL_Rect));
+  dirty->lastX = (int*)calloc(n, sizeof(int));
+  dirty->lastY = (int*)calloc(n, sizeof(int));
+  dirty->stillFrames = (int*)calloc(n, sizeof(int));
+  dirty->rects = (SDL_Rect*)malloc(DIRTY_MAX_RECTS * sizeof(SDL_Rect));
+  dirty->n_rects = 0;
+  dirty->n = n;
+  dirty->level = -1;
+  dirty->fullRedraw = 1;
+  return dirty;
 }
 
-void applyGravityToBall(Circle* ball) {
-  ball->coords->y += ball->yvel;
-  ball->coords->x += ball->xvel;
-  if (ball->coords->y < HEIGHT - ball->radius) ball->yvel += GRAVITY;
+void deleteDirtyRenderer(DirtyRenderer* dirty) {
+  SDL_DestroyTexture(dirty->frame);
+  free(dirty->drawn);
+  free(dirty->lastX);
+  free(dirty->lastY);
+  free(dirty->stillFrames);
+  free(dirty->rects);
+  free(dirty);
 }
 
-void applyGravity(Circle** balls, int n) {
-  for (int i = 0; i < n; i++) if (!balls[i]->isInteracted) applyGravityToBall(balls[i]);
+// Folds the rect into one it overlaps (overlapping repaints are harmless, just wasted), 0 once there are too many to be worth it
+int addDirtyRect(DirtyRenderer* dirty, SDL_Rect* rect) {
+  for (int k = 0; k < dirty->n_rects; k++) {
+    if (SDL_HasIntersection(&dirty->rects[k], rect)) {
+      SDL_UnionRect(&dirty->rects[k], rect, &dirty->rects[k]);
+      return 1;
+    }
+  }
+
+  if (dirty->n_rects == DIRTY_MAX_RECTS) return 0;
+  dirty->rects[dirty->n_rects++] = *rect;
+  return 1;
 }
 
-void reflectionFrictionAndDampingToBall(Circle* ball) {
-  if (ball->coords->y >= HEIGHT - ball->radius || ball->coords->y < ball->radius) {
-    if ((ball->coords->y >= HEIGHT - ball->radius || ball->coords->y <= ball->radius) && fabs(ball->yvel) <= MIN_YVEL) ball->yvel = 0;
-    else ball->yvel = (-1) * (ball->yvel * Y_DAMP_COEFF);
+void repaintRect(SDL_Renderer* renderer, Circle** balls, int n, QualitySettings* quality, SDL_Rect* drawn, SDL_Rect* rect) {
+  SDL_RenderSetClipRect(renderer, rect);
+  setRendererDrawColor(renderer, COLOR_BLACK);
+  SDL_RenderFillRect(renderer, rect);
+
+  // Same order as a full frame, trails under all balls, so overlaps come out identical
+  for (int i = 0; i < n; i++) if (isTrailVisible(balls[i], quality) && SDL_HasIntersection(&drawn[i], rect)) drawPathForBall(renderer, balls[i], quality->trailLength);
+  for (int i = 0; i < n; i++) {
+    SDL_Rect bounds = ballBounds(balls[i], quality);
+    if (SDL_HasIntersection(&bounds, rect)) drawBall(renderer, balls[i], quality);
+  }
+}
 
-    if (ball->coords->y >= HEIGHT - ball->radius) ball->coords->y = HEIGHT - ball->radius;
-    else ball->coords->y = ball->radius;
+// Keep the last frame in a texture and only repaint around balls that moved, a ball whose pixel hasn't changed for longer than its trail lasts looks exactly the same as last frame
+void drawDirtyFrame(SDL_Renderer* renderer, DirtyRenderer* dirty, Circle** balls, int n, int level) {
+  QualitySettings* quality = &QUALITY_LEVELS[level];
+  int fullRedraw = dirty->fullRedraw || level != dirty->level;
+  long dirtyArea = 0;
+  dirty->n_rects = 0;
 
-    ball->xvel = (ball->xvel * INVERSE_FRICTION_COEFF);
+  for (int i = 0; i < n; i++) {
+    int x = balls[i]->coords->x, y = balls[i]->coords->y;
+    if (x == dirty->lastX[i] && y == dirty->lastY[i]) dirty->stillFrames[i]++;
+    else dirty->stillFrames[i] = 0;
+    dirty->lastX[i] = x;
+    dirty->lastY[i] = y;
+
+    SDL_Rect previous = dirty->drawn[i];
+    dirty->drawn[i] = drawnBounds(balls[i], quality);
+    if (fullRedraw || dirty->stillFrames[i] > PATH_TRACE_LENGTH) continue;
+
+    SDL_Rect changed;
+    SDL_UnionRect(&previous, &dirty->drawn[i], &changed);
+    dirtyArea += (long)changed.w * changed.h;
+    if (!addDirtyRect(dirty, &changed) || dirtyArea > DIRTY_FULL_REDRAW_AT * WIDTH * HEIGHT) fullRedraw = 1;
   }
 
-  if (ball->coords->x >= WIDTH - ball->radius || ball->coords->x < ball->radius) {
-    if (((ball->coords->x >= WIDTH - ball->radius || ball->coords->x <= ball->radius) && fabs(ball->xvel) <= MIN_XVEL)) ball->xvel = 0;
-    else ball->xvel = (-1) * (ball->xvel * X_DAMP_COEFF);
+  // The frame texture can't be drawn into (some backends lose targets with the device), repaint the screen instead and the texture once it works again
+  if (SDL_SetRenderTarget(renderer, dirty->frame) != 0) {
+    drawFullFrame(renderer, balls, n, quality);
+    dirty->fullRedraw = 1;
+    return;
+  }
 
-    if (ball->coords-> x >= WIDTH - ball->radius) ball->coords->x = WIDTH - ball->radius;
-    else ball->coords->x = ball->radius;
+  if (fullRedraw) drawFullFrame(renderer, balls, n, quality);
+  else {
+    for (int k = 0; k < dirty->n_rects; k++) repaintRect(renderer, balls, n, quality, dirty->drawn, &dirty->rects[k]);
+    SDL_RenderSetClipRect(renderer, NULL);
   }
 
-  // printf("vvel: %f, y: %f\n", ball->yvel, ball->y);
+  dirty->fullRedraw = 0;
+  dirty->level = level;
+  SDL_SetRenderTarget(renderer, NULL);
+  SDL_RenderCopy(renderer, dirty->frame, NULL, NULL);
 }
 
-void reflectionFrictionAndDamping(Circle** balls, int n){
-  for (int i = 0; i < n; i++) reflectionFrictionAndDampingToBall(balls[i]);
+QualityGovernor* createQualityGovernor(int fps) {
+  QualityGovernor* governor = (QualityGovernor*)malloc(sizeof(QualityGovernor));
+  governor->targetMs = 1000.0 / fps;
+  governor->avgMs = 0;
+  governor->level = 0;
+  governor->cooldown = 0;
+  governor->calmFrames = 0;
+  return governor;
+}
+
+// Drop a level as soon as frames get close to the budget (or one blows it), only climb back after a long calm stretch so quality doesn't flicker
+void updateQualityGovernor(QualityGovernor* governor, double frameMs) {
+  int maxLevel = sizeof(QUALITY_LEVELS) / sizeof(QualitySettings) - 1;
+  governor->avgMs = governor->avgMs * (1 - GOVERNOR_SMOOTHING) + frameMs * GOVERNOR_SMOOTHING;
+  if (governor->cooldown) governor->cooldown--;
+
+  if ((governor->avgMs > governor->targetMs * GOVERNOR_DEGRADE_AT || frameMs > governor->targetMs) && !governor->cooldown) {
+    if (governor->level < maxLevel) governor->level++;
+    governor->cooldown = GOVERNOR_COOLDOWN_FRAMES;
+    governor->calmFrames = 0;
+    return;
+  }
+
+  if (governor->avgMs < governor->targetMs * GOVERNOR_RESTORE_AT) governor->calmFrames++;
+  else governor->calmFrames = 0;
+
+  if (governor->calmFrames >= GOVERNOR_RESTORE_FRAMES && governor->level > 0) {
+    governor->level--;
+    governor->calmFrames = 0;
+  }
 }
 
 void reInitiateMousePath(Circle* ball) {
@@ -313,70 +446,6 @@ Circle* whichBallInBallInteraction(Circle** balls, int n, double x, double y) {
   return NULL;
 }
 
-void collisionTrajectory(Circle* ball1, Circle* ball2) {
-  double dx = ball2->coords->x - ball1->coords->x;
-  double dy = ball2->coords->y - ball1->coords->y;
-  double distance = sqrt(dx * dx + dy * dy);
-
-  if (!distance) return;
-
-  // Normal vectors along line of impact
-  double nx = dx / distance;
-  double ny = dy / distance;
-
-  // Tangent vectors perpendicular to line of impact, NOT THE COORDINATE GEOMETRY (DISINTEGRATING_CRYING_EMOJI.GIF)
-  double tx = -ny;
-  double ty = nx;
-  
-  // Readjusting the colling balls coordinates so they don't just get embedded
-  double rad_dist = ball1->radius + ball2->radius;
-  double rad_dist_diff = fabs(rad_dist - distance);
-  if (rad_dist_diff >= 0) {
-    // Focus on vector directions, ANOTHER MOTION PHYSICS AND COORDINATE GEOMETRY, TIRED OF WATCHING MORE PHYSICS WALLAH LECTURES
-    ball1->coords->x -= (rad_dist_diff / 2) * nx;
-    ball1->coords->y -= (rad_dist_diff / 2) * ny;
-    ball2->coords->x += (rad_dist_diff / 2) * nx;
-    ball2->coords->y += (rad_dist_diff / 2) * ny;
-    
-  }
-
-  // Dot product of the velocity vectors with the normal and tangent, need to make sure velocities in tangest directions remains same and change only in line of impact direction, thus making it simulate like a 1D collision
-  double dpTan1 = ball1->xvel * tx + ball1->yvel * ty;
-  double dpTan2 = ball2->xvel * tx + ball2->yvel * ty;
-
-  double dpNorm1 = ball1->xvel * nx + ball1->yvel * ny;
-  double dpNorm2 = ball2->xvel * nx + ball2->yvel * ny;
-
-  // Calculate the relative normal velocity to get final velocities after COEFF_OF_RESTITUTION damping of balls
-  double relativeNormalVelocity = dpNorm2 - dpNorm1;
-
-  // Update normal velocities using the coefficient of restitution, e = (relocity of separation)/(velocity of approach), therefore updating final velocities with COEFF_OF_RESTITUTION and since mass density is same for balls, we can distribute momentum assosiated with mass with radii of balls
-  double v1n = dpNorm1 + (1 + COEFF_OF_RESTITUTION) * (ball2->radius / (ball1->radius + ball2->radius)) * relativeNormalVelocity;
-  double v2n = dpNorm2 - (1 + COEFF_OF_RESTITUTION) * (ball1->radius / (ball1->radius + ball2->radius)) * relativeNormalVelocity;
-
-  // Convert the normal and tangent velocities into vectors, like xvel = TangentVel * tangent-x-component-cap + final-velocity * normal-x-component-cap
-  ball1->xvel = tx * dpTan1 + nx * v1n;
-  ball1->yvel = ty * dpTan1 + ny * v1n;
-
-  ball2->xvel = tx * dpTan2 + nx * v2n;
-  ball2->yvel = ty * dpTan2 + ny * v2n;
-}
-
-void applyCollisionMechanics(Circle** balls, int n) {
-  float dist_sq = 0, x_sq = 0, y_sq = 0, rad_sq = 0;
-  for (int i = 0; i < n - 1; i++) {
-    for (int j = i + 1; j < n; j++) {
-      x_sq = balls[i]->coords->x - balls[j]->coords->x;
-      y_sq = balls[i]->coords->y - balls[j]->coords->y;
-      rad_sq = balls[i]->radius + balls[j]->radius;
-      x_sq *= x_sq, y_sq *= y_sq, rad_sq *= rad_sq;
-
-      dist_sq = x_sq + y_sq;
-      if (dist_sq <= rad_sq) collisionTrajectory(balls[i], balls[j]);
-    }
-  }
-}
-
 int charArgtoInt(char* arg) {
   if (!arg) return 0;
   int num = 0, i = 0, n = strlen(arg);
@@ -402,6 +471,12 @@ int main(int argc, char** argv) {
   int CapEnabled = argc > 2 ? (charArgtoInt(argv[2]) == 1 ? 0 : 1) : 1;
   if (CapEnabled) capBallsCount(&N_BALLS);
 
+  SceneSpec spec = { SCENE_LAYOUT, N_BALLS, RADIUS, RADIUS, SCENE_SEED, VELOCITY_ZERO, 0 };
+  if (argc > 3 && charArgtoInt(argv[3]) <= SCENE_RANDOM) spec.layout = (SceneLayout)charArgtoInt(argv[3]);
+  if (argc > 4 && charArgtoInt(argv[4]) > 0) spec.minRadius = spec.maxRadius = charArgtoInt(argv[4]);
+  if (argc > 5 && charArgtoInt(argv[5]) >= spec.minRadius) spec.maxRadius = charArgtoInt(argv[5]);
+  if (argc > 6 && charArgtoInt(argv[6]) > 0) spec.seed = charArgtoInt(argv[6]);
+
   SDL_Init(SDL_INIT_VIDEO);
   SDL_Window* window = SDL_CreateWindow("Bouncy Ball Simulation", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WIDTH, HEIGHT, 0);
   SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
@@ -411,9 +486,17 @@ int main(int argc, char** argv) {
   setRendererDrawColor(renderer, COLOR_BLACK);
   SDL_RenderClear(renderer);
 
-  Circle** balls = createBalls(N_BALLS);
-
-  drawBalls(renderer, balls, N_BALLS);
+  World* world = createScene(defaultWorldParams(), WIDTH, HEIGHT, &spec);
+  Circle** balls = world->balls;
+  if (world->n < N_BALLS) printf("ONLY %d OF %d BALLS FIT IN THE SCENE.\n", world->n, N_BALLS);
+  N_BALLS = world->n;
+  for (int i = 0; i < N_BALLS; i++) balls[i]->color = COLORS[rand() % (sizeof(COLORS) / sizeof(Uint32))];
+
+  QualityGovernor* governor = createQualityGovernor(SIMULATION_FPS);
+  int governorEnabled = QUALITY_GOVERNOR;
+  SDL_Texture* trailTexture = TEXTURE_TRAILS ? createTrailTexture(renderer) : NULL;
+  DirtyRenderer* dirty = DIRTY_RECTS ? createDirtyRenderer(renderer, N_BALLS) : NULL;
+  drawBalls(renderer, balls, N_BALLS, &QUALITY_LEVELS[0]);
   SDL_RenderPresent(renderer);
 
   SDL_Event event;
@@ -421,7 +504,9 @@ int main(int argc, char** argv) {
   int mousePressed = 0;
   int justReleasedMouse = 0;
   Circle* WBall = NULL;
+  EventEngine* engine = EVENT_DRIVEN_ENGINE ? createEventEngine(world) : NULL;
   while (simulation_running) {
+    Uint64 frameStart = SDL_GetPerformanceCounter();
     while (SDL_PollEvent(&event)) {
       switch (event.type) {
         case SDL_QUIT:
@@ -433,6 +518,32 @@ int main(int argc, char** argv) {
             case SDLK_ESCAPE:
               simulation_running = 0;
               break;
+
+            case SDLK_e: // Switch between the fixed-step loop and the event-driven engine, balls are always synced to the frame so nothing is lost
+              if (engine) {
+                deleteEventEngine(engine);
+                engine = NULL;
+              } else engine = createEventEngine(world);
+              break;
+
+            case SDLK_t: // Paths grow back to full length on their own after switching back to line trails
+              if (trailTexture) {
+                SDL_DestroyTexture(trailTexture);
+                trailTexture = NULL;
+              } else if (!(trailTexture = createTrailTexture(renderer))) printf("RENDERER CAN'T DRAW INTO OR FADE TEXTURES, STAYING WITH LINE TRAILS.\n");
+              break;
+
+            case SDLK_d:
+              if (dirty) {
+                deleteDirtyRenderer(dirty);
+                dirty = NULL;
+              } else if (!(dirty = createDirtyRenderer(renderer, N_BALLS))) printf("RENDERER CAN'T DRAW INTO TEXTURES, STAYING WITH FULL REPAINTS.\n");
+              break;
+
+            case SDLK_g: // Governor off always draws at full quality
+              governorEnabled = !governorEnabled;
+              governor->level = 0;
+              break;
           }
       }
 
@@ -447,11 +558,13 @@ int main(int argc, char** argv) {
           WBall->coords->x = event.button.x;
           WBall->coords->y = event.button.y;
           reInitiateMousePath(WBall); // DEPRECATED: When mouse if clicked on a ball, remove path since a new path will be generated from user interaction, therefore no need to weight average old unrelated path points
+          if (engine) touchBall(engine, WBall); // Held ball drops out of the engine until released
         } else if (event.type == SDL_MOUSEBUTTONUP && WBall) { // When we hovered over a ball and released our mouse button, reset its state and calculate its trajectory
           mousePressed = 0;
           justReleasedMouse = 1;
           WBall->isInteracted = 0;
           calculateTrajectory(WBall, &justReleasedMouse);
+          if (engine) touchBall(engine, WBall);
         } else if (WBall && WBall->isInteracted) { // When user is interacting with the mouse
           WBall->coords->x = event.button.x;
           WBall->coords->y = event.button.y;
@@ -461,27 +574,32 @@ int main(int argc, char** argv) {
       }
     }
 
-    setRendererDrawColor(renderer, COLOR_BLACK);
-    SDL_RenderClear(renderer);
-
-    // if (!mousePressed) applyGravity(ball1);
-    applyGravity(balls, N_BALLS);
+    if (engine) advanceEventEngine(engine, 1);
+    else stepWorld(world);
 
-    reflectionFrictionAndDamping(balls, N_BALLS);
-
-    applyCollisionMechanics(balls, N_BALLS);
-
-    nextPointsIntoPaths(balls, N_BALLS);
+    QualitySettings* quality = &QUALITY_LEVELS[governor->level];
+    // Texture trails only need the points calculateTrajectory() averages over, not the whole trail
+    nextPointsIntoPaths(balls, N_BALLS, trailTexture ? TRAJECTORY_AVG_SIZE + 1 : PATH_TRACE_LENGTH);
     // printf("%d\n", i++);
-    drawPaths(renderer, balls, N_BALLS);
-
-    drawBalls(renderer, balls, N_BALLS);
+    if (trailTexture) { // The fade touches every pixel each frame, nothing to gain from dirty rects here
+      drawTrailTexture(renderer, trailTexture, balls, N_BALLS, quality);
+      drawBalls(renderer, balls, N_BALLS, quality);
+      if (dirty) dirty->fullRedraw = 1;
+    } else if (dirty) drawDirtyFrame(renderer, dirty, balls, N_BALLS, governor->level);
+    else drawFullFrame(renderer, balls, N_BALLS, quality);
     SDL_RenderPresent(renderer);
 
-    SDL_Delay(getFPS(SIMULATION_FPS));
+    // Sleep only what is left of the frame, a fixed delay on top of the work is what made heavy frames run late
+    double frameMs = (double)(SDL_GetPerformanceCounter() - frameStart) * 1000 / SDL_GetPerformanceFrequency();
+    if (governorEnabled) updateQualityGovernor(governor, frameMs);
+    if (frameMs < getFPS(SIMULATION_FPS)) SDL_Delay(getFPS(SIMULATION_FPS) - frameMs);
   }
   
-  deleteBalls(balls, N_BALLS);
+  if (engine) deleteEventEngine(engine);
+  free(governor);
+  if (trailTexture) SDL_DestroyTexture(trailTexture);
+  if (dirty) deleteDirtyRenderer(dirty);
+  deleteWorld(world);
 
   SDL_DestroyRenderer(renderer);
   SDL_DestroyWindow(window);
@@ -490,5 +608,5 @@ int main(int argc, char** argv) {
   return 0;
 }
 
-// COMPILE: gcc -o main2 main2.c `sdl2-config --cflags --libs` -lm
-// RUN: main2 <(optional) no. of balls> <(optional) Disable Ball capping>
\ No newline at end of file
+// COMPILE: gcc -o main2 main2.c physics.c `sdl2-config --cflags --libs` -lm
+// RUN: main2 <(optional) no. of balls> <(optional) Disable Ball capping> <(optional) layout 0 line 1 hex 2 poisson 3 random> <(optional) min radius> <(optional) max radius> <(optional) seed>
\ No newline at end of file
@@ -0,0 +1,1365 @@
+#include "physics.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+Point* createPoint(double x, double y) {
+  Point* pt = (Point*)malloc(sizeof(Point));
+  pt->x = x;
+  pt->y = y;
+  pt->next = NULL;
+  pt->prev = NULL;
+  return pt;
+}
+
+Path* createPath(int pathLen, Point* start) {
+  Point* pt = createPoint(start->x, start->y);
+  Path* path = (Path*)malloc(sizeof(Path));
+  path->st = pt;
+  path->top = pt;
+  path->n_points = 1;
+  return path;
+}
+
+// path linked list keeps its own copies of ball->coords, so deleteBall() frees both
+Circle* createBall(Point* start, double radius, double xvel, double yvel, uint32_t color) {
+  Circle* circle = (Circle*)malloc(sizeof(Circle));
+  circle->coords = start;
+  circle->radius = radius;
+  circle->xvel = xvel;
+  circle->yvel = yvel;
+  circle->color = color;
+  circle->path = createPath(PATH_TRACE_LENGTH, start);
+  circle->isInteracted = 0;
+  circle->t = 0;
+  circle->nEvents = 0;
+  circle->restingOn = NULL;
+  return circle;
+}
+
+// maxPoints can shrink between calls, the oldest points are dropped until the path fits again
+void nextPointIntoPath(Circle* ball, int maxPoints) {
+  Point* pt = createPoint(ball->coords->x, ball->coords->y);
+
+  ball->path->top->next = pt;
+  pt->prev = ball->path->top;
+  ball->path->top = pt;
+  ball->path->n_points++;
+
+  while (ball->path->n_points > maxPoints && ball->path->st != ball->path->top) {
+    Point* temp = ball->path->st;
+    ball->path->st = ball->path->st->next;
+    ball->path->st->prev = NULL;
+    free(temp);
+    ball->path->n_points--;
+  }
+
+  // printf("pt->y: %f\tpath->top->y: %f\n", pt->y, path->top->y);
+}
+
+void nextPointsIntoPaths(Circle** balls, int n, int maxPoints) {
+  for (int i = 0; i < n; i++) nextPointIntoPath(balls[i], maxPoints);
+}
+
+void deletePath(Circle* ball) {
+  Point* tr = ball->path->st;
+  while (tr) {
+    Point* temp = tr;
+    // printf("%d\t%f\n", path->n_points--, temp->y);
+    tr = tr->next;
+    free(temp);
+  }
+  free(ball->path);
+}
+
+void deleteBall(Circle* ball) {
+  deletePath(ball);
+  free(ball->coords); // createPath() copies the start point, so the path never holds ball->coords itself
+  free(ball);
+}
+
+void deleteBalls(Circle** balls, int n) {
+  for (int i = 0; i < n; i++) deleteBall(balls[i]);
+  free(balls);
+}
+
+WorldParams defaultWorldParams(void) {
+  WorldParams params;
+  params.gravity = GRAVITY;
+  params.coeffOfRestitution = COEFF_OF_RESTITUTION;
+  params.xDampCoeff = X_DAMP_COEFF;
+  params.yDampCoeff = Y_DAMP_COEFF;
+  params.inverseFrictionCoeff = INVERSE_FRICTION_COEFF;
+  params.minXvel = MIN_XVEL;
+  params.minYvel = MIN_YVEL;
+  return params;
+}
+
+void deleteWorld(World* world) {
+  deleteBalls(world->balls, world->n);
+  deleteSpatialHash(world->hash);
+  free(world);
+}
+
+void applyGravityToBall(World* world, Circle* ball) {
+  ball->coords->y += ball->yvel;
+  ball->coords->x += ball->xvel;
+  if (ball->coords->y < world->height - ball->radius) ball->yvel += world->params.gravity;
+}
+
+void applyGravity(World* world) {
+  for (int i = 0; i < world->n; i++) if (!world->balls[i]->isInteracted) applyGravityToBall(world, world->balls[i]);
+}
+
+void reflectionFrictionAndDampingToBall(World* world, Circle* ball) {
+  if (ball->coords->y >= world->height - ball->radius || ball->coords->y < ball->radius) {
+    if ((ball->coords->y >= world->height - ball->radius || ball->coords->y <= ball->radius) && fabs(ball->yvel) <= world->params.minYvel) ball->yvel = 0;
+    else ball->yvel = (-1) * (ball->yvel * world->params.yDampCoeff);
+
+    if (ball->coords->y >= world->height - ball->radius) ball->coords->y = world->height - ball->radius;
+    else ball->coords->y = ball->radius;
+
+    ball->xvel = (ball->xvel * world->params.inverseFrictionCoeff);
+  }
+
+  if (ball->coords->x >= world->width - ball->radius || ball->coords->x < ball->radius) {
+    if (((ball->coords->x >= world->width - ball->radius || ball->coords->x <= ball->radius) && fabs(ball->xvel) <= world->params.minXvel)) ball->xvel = 0;
+    else ball->xvel = (-1) * (ball->xvel * world->params.xDampCoeff);
+
+    if (ball->coords-> x >= world->width - ball->radius) ball->coords->x = world->width - ball->radius;
+    else ball->coords->x = ball->radius;
+  }
+
+  // printf("vvel: %f, y: %f\n", ball->yvel, ball->y);
+}
+
+void reflectionFrictionAndDamping(World* world){
+  for (int i = 0; i < world->n; i++) reflectionFrictionAndDampingToBall(world, world->balls[i]);
+}
+
+void collisionTrajectory(World* world, Circle* ball1, Circle* ball2) {
+  double dx = ball2->coords->x - ball1->coords->x;
+  double dy = ball2->coords->y - ball1->coords->y;
+  double distance = sqrt(dx * dx + dy * dy);
+
+  if (!distance) return;
+
+  // Normal vectors along line of impact
+  double nx = dx / distance;
+  double ny = dy / distance;
+
+  // Tangent vectors perpendicular to line of impact, NOT THE COORDINATE GEOMETRY (DISINTEGRATING_CRYING_EMOJI.GIF)
+  double tx = -ny;
+  double ty = nx;
+  
+  // Readjusting the colling balls coordinates so they don't just get embedded
+  double rad_dist = ball1->radius + ball2->radius;
+  double rad_dist_diff = fabs(rad_dist - distance);
+  if (rad_dist_diff >= 0) {
+    // Focus on vector directions, ANOTHER MOTION PHYSICS AND COORDINATE GEOMETRY, TIRED OF WATCHING MORE PHYSICS WALLAH LECTURES
+    ball1->coords->x -= (rad_dist_diff / 2) * nx;
+    ball1->coords->y -= (rad_dist_diff / 2) * ny;
+    ball2->coords->x += (rad_dist_diff / 2) * nx;
+    ball2->coords->y += (rad_dist_diff / 2) * ny;
+    
+  }
+
+  // Dot product of the velocity vectors with the normal and tangent, need to make sure velocities in tangest directions remains same and change only in line of impact direction, thus making it simulate like a 1D collision
+  double dpTan1 = ball1->xvel * tx + ball1->yvel * ty;
+  double dpTan2 = ball2->xvel * tx + ball2->yvel * ty;
+
+  double dpNorm1 = ball1->xvel * nx + ball1->yvel * ny;
+  double dpNorm2 = ball2->xvel * nx + ball2->yvel * ny;
+
+  // Calculate the relative normal velocity to get final velocities after COEFF_OF_RESTITUTION damping of balls
+  double relativeNormalVelocity = dpNorm2 - dpNorm1;
+
+  // Update normal velocities using the coefficient of restitution, e = (relocity of separation)/(velocity of approach), therefore updating final velocities with COEFF_OF_RESTITUTION and since mass density is same for balls, we can distribute momentum assosiated with mass with radii of balls
+  double v1n = dpNorm1 + (1 + world->params.coeffOfRestitution) * (ball2->radius / (ball1->radius + ball2->radius)) * relativeNormalVelocity;
+  double v2n = dpNorm2 - (1 + world->params.coeffOfRestitution) * (ball1->radius / (ball1->radius + ball2->radius)) * relativeNormalVelocity;
+
+  // Convert the normal and tangent velocities into vectors, like xvel = TangentVel * tangent-x-component-cap + final-velocity * normal-x-component-cap
+  ball1->xvel = tx * dpTan1 + nx * v1n;
+  ball1->yvel = ty * dpTan1 + ny * v1n;
+
+  ball2->xvel = tx * dpTan2 + nx * v2n;
+  ball2->yvel = ty * dpTan2 + ny * v2n;
+}
+
+void collideIfTouching(World* world, Circle* ball1, Circle* ball2) {
+  float x_sq = ball1->coords->x - ball2->coords->x;
+  float y_sq = ball1->coords->y - ball2->coords->y;
+  float rad_sq = ball1->radius + ball2->radius;
+  x_sq *= x_sq, y_sq *= y_sq, rad_sq *= rad_sq;
+
+  if (x_sq + y_sq <= rad_sq) collisionTrajectory(world, ball1, ball2);
+}
+
+SpatialHash* createSpatialHash(void) {
+  SpatialHash* hash = (SpatialHash*)calloc(1, sizeof(SpatialHash));
+  for (int l = 0; l < HASH_LEVELS; l++) hash->levels[l].cellSize = HASH_BASE_CELL * (double)(1 << l);
+  return hash;
+}
+
+void deleteSpatialHash(SpatialHash* hash) {
+  for (int l = 0; l < HASH_LEVELS; l++) {
+    free(hash->levels[l].bucketStart);
+    free(hash->levels[l].entries);
+    free(hash->levels[l].cellX);
+    free(hash->levels[l].cellY);
+  }
+  free(hash->ballLevel);
+  free(hash);
+}
+
+// Finest level whose cells fit the ball's diameter
+int hashLevelFor(double radius) {
+  int l = 0;
+  while (l < HASH_LEVELS - 1 && HASH_BASE_CELL * (double)(1 << l) < 2 * radius) l++;
+  return l;
+}
+
+unsigned int hashCell(int cx, int cy, int tableSize) {
+  return (((unsigned int)cx * 73856093u) ^ ((unsigned int)cy * 19349663u)) & (tableSize - 1);
+}
+
+int cellOf(double coord, double cellSize) {
+  return (int)floor(coord / cellSize);
+}
+
+// Counting sort of every ball into its level's buckets, all arrays are reused from frame to frame
+void buildSpatialHash(SpatialHash* hash, Circle** balls, int n) {
+  if (n > hash->capacity) {
+    int tableSize = 1;
+    while (tableSize < 2 * n) tableSize <<= 1;
+
+    hash->capacity = n;
+    hash->ballLevel = (int*)realloc(hash->ballLevel, n * sizeof(int));
+    for (int l = 0; l < HASH_LEVELS; l++) {
+      HashLevel* level = &hash->levels[l];
+      level->bucketStart = (int*)realloc(level->bucketStart, (tableSize + 1) * sizeof(int));
+      level->entries = (int*)realloc(level->entries, n * sizeof(int));
+      level->cellX = (int*)realloc(level->cellX, n * sizeof(int));
+      level->cellY = (int*)realloc(level->cellY, n * sizeof(int));
+    }
+  }
+
+  for (int l = 0; l < HASH_LEVELS; l++) {
+    hash->levels[l].n = 0;
+    hash->levels[l].maxRadius = 0;
+  }
+
+  for (int i = 0; i < n; i++) {
+    int l = hashLevelFor(balls[i]->radius);
+    hash->ballLevel[i] = l;
+    hash->levels[l].n++;
+    if (balls[i]->radius > hash->levels[l].maxRadius) hash->levels[l].maxRadius = balls[i]->radius;
+  }
+
+  for (int l = 0; l < HASH_LEVELS; l++) {
+    HashLevel* level = &hash->levels[l];
+    if (!level->n) continue;
+    level->tableSize = 1;
+    while (level->tableSize < 2 * level->n) level->tableSize <<= 1;
+    memset(level->bucketStart, 0, (level->tableSize + 1) * sizeof(int));
+  }
+
+  // Count per bucket, prefix sum, then place, bucketStart[b] ends up as the start of bucket b
+  for (int i = 0; i < n; i++) {
+    HashLevel* level = &hash->levels[hash->ballLevel[i]];
+    level->bucketStart[hashCell(cellOf(balls[i]->coords->x, level->cellSize), cellOf(balls[i]->coords->y, level->cellSize), level->tableSize) + 1]++;
+  }
+  for (int l = 0; l < HASH_LEVELS; l++) {
+    HashLevel* level = &hash->levels[l];
+    if (!level->n) continue;
+    for (int b = 0; b < level->tableSize; b++) level->bucketStart[b + 1] += level->bucketStart[b];
+  }
+  for (int i = 0; i < n; i++) {
+    HashLevel* level = &hash->levels[hash->ballLevel[i]];
+    int cx = cellOf(balls[i]->coords->x, level->cellSize);
+    int cy = cellOf(balls[i]->coords->y, level->cellSize);
+    int slot = level->bucketStart[hashCell(cx, cy, level->tableSize)]++;
+    level->entries[slot] = i;
+    level->cellX[slot] = cx;
+    level->cellY[slot] = cy;
+  }
+  // Placing moved every start to the next bucket's start, shift back
+  for (int l = 0; l < HASH_LEVELS; l++) {
+    HashLevel* level = &hash->levels[l];
+    if (!level->n) continue;
+    for (int b = level->tableSize; b > 0; b--) level->bucketStart[b] = level->bucketStart[b - 1];
+    level->bucketStart[0] = 0;
+  }
+}
+
+// Each ball only looks at its own level and coarser ones, so every pair is found once, from its smaller ball
+void applyCollisionMechanicsHashed(World* world) {
+  Circle** balls = world->balls;
+  SpatialHash* hash = world->hash;
+  buildSpatialHash(hash, balls, world->n);
+
+  for (int i = 0; i < world->n; i++) {
+    Circle* ball = balls[i];
+    int own = hash->ballLevel[i];
+
+    for (int l = own; l < HASH_LEVELS; l++) {
+      HashLevel* level = &hash->levels[l];
+      if (!level->n) continue;
+
+      // One cell around is enough while both radii fit the cell, only the last level can hold balls bigger than that
+      int range = (int)ceil((ball->radius + level->maxRadius) / level->cellSize);
+      if (range < 1) range = 1;
+      int cx = cellOf(ball->coords->x, level->cellSize);
+      int cy = cellOf(ball->coords->y, level->cellSize);
+
+      for (int x = cx - range; x <= cx + range; x++) {
+        for (int y = cy - range; y <= cy + range; y++) {
+          unsigned int b = hashCell(x, y, level->tableSize);
+          for (int k = level->bucketStart[b]; k < level->bucketStart[b + 1]; k++) {
+            int j = level->entries[k];
+            if (level->cellX[k] != x || level->cellY[k] != y) continue;
+            if (l == own && j <= i) continue;
+            collideIfTouching(world, ball, balls[j]);
+          }
+        }
+      }
+    }
+  }
+}
+
+void applyCollisionMechanics(World* world) {
+  Circle** balls = world->balls;
+  int n = world->n;
+  if (n >= HASH_MIN_BALLS) {
+    applyCollisionMechanicsHashed(world);
+    return;
+  }
+
+  for (int i = 0; i < n - 1; i++) {
+    for (int j = i + 1; j < n; j++) collideIfTouching(world, balls[i], balls[j]);
+  }
+}
+
+// One frame of the fixed-step loop
+void stepWorld(World* world) {
+  applyGravity(world);
+  reflectionFrictionAndDamping(world);
+  applyCollisionMechanics(world);
+}
+
+// SCENE GENERATORS: PLACE BALLS WITHOUT ANY OVERLAP SO THE FIRST FRAMES DON'T START WITH A PILE OF DEEP PENETRATIONS
+
+// xorshift64*, rand() is neither thread-safe nor reproducible across worlds
+double randomUnit(uint64_t* state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return (double)((*state * 2685821657736338717ULL) >> 11) / (double)(1ULL << 53);
+}
+
+double randomGaussian(uint64_t* state) {
+  double u = randomUnit(state);
+  while (u <= 0) u = randomUnit(state);
+  return sqrt(-2 * log(u)) * cos(2 * M_PI * randomUnit(state));
+}
+
+// Same levels as the spatial hash, but filled one ball at a time while placing, so buckets are linked lists instead of a counting sort
+typedef struct PlacementLevel {
+  double cellSize;
+  double maxRadius;
+  int n;
+  int tableSize;
+  int* head; // first ball of every bucket, -1 when empty
+} PlacementLevel;
+
+typedef struct PlacementGrid {
+  PlacementLevel levels[HASH_LEVELS];
+  int* next; // next ball in the same bucket
+  double* x;
+  double* y;
+  double* radius;
+} PlacementGrid;
+
+// Radii must be known up front so every level's table can be sized once
+PlacementGrid* createPlacementGrid(double* radii, int n) {
+  PlacementGrid* grid = (PlacementGrid*)calloc(1, sizeof(PlacementGrid));
+  grid->next = (int*)malloc(n * sizeof(int));
+  grid->x = (double*)malloc(n * sizeof(double));
+  grid->y = (double*)malloc(n * sizeof(double));
+  grid->radius = (double*)malloc(n * sizeof(double));
+
+  int counts[HASH_LEVELS] = {0};
+  for (int i = 0; i < n; i++) counts[hashLevelFor(radii[i])]++;
+
+  for (int l = 0; l < HASH_LEVELS; l++) {
+    PlacementLevel* level = &grid->levels[l];
+    level->cellSize = HASH_BASE_CELL * (double)(1 << l);
+    level->tableSize = 1;
+    while (level->tableSize < 2 * counts[l]) level->tableSize <<= 1;
+    level->head = (int*)malloc(level->tableSize * sizeof(int));
+    memset(level->head, -1, level->tableSize * sizeof(int));
+  }
+  return grid;
+}
+
+void deletePlacementGrid(PlacementGrid* grid) {
+  for (int l = 0; l < HASH_LEVELS; l++) free(grid->levels[l].head);
+  free(grid->next);
+  free(grid->x);
+  free(grid->y);
+  free(grid->radius);
+  free(grid);
+}
+
+// Coarsest level first, a rejected spot is almost always rejected by a big neighbour and the fine levels are the expensive ones to scan around a big ball
+int fitsInPlacementGrid(PlacementGrid* grid, double x, double y, double radius) {
+  for (int l = HASH_LEVELS - 1; l >= 0; l--) {
+    PlacementLevel* level = &grid->levels[l];
+    if (!level->n) continue;
+
+    int range = (int)ceil((radius + level->maxRadius + SCENE_GAP) / level->cellSize);
+    int cx = cellOf(x, level->cellSize);
+    int cy = cellOf(y, level->cellSize);
+
+    for (int i = cx - range; i <= cx + range; i++) {
+      for (int j = cy - range; j <= cy + range; j++) {
+        for (int k = level->head[hashCell(i, j, level->tableSize)]; k >= 0; k = grid->next[k]) {
+          double dx = grid->x[k] - x, dy = grid->y[k] - y, rad_dist = grid->radius[k] + radius + SCENE_GAP;
+          if (dx * dx + dy * dy < rad_dist * rad_dist) return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+void insertIntoPlacementGrid(PlacementGrid* grid, int i, double x, double y, double radius) {
+  PlacementLevel* level = &grid->levels[hashLevelFor(radius)];
+  unsigned int b = hashCell(cellOf(x, level->cellSize), cellOf(y, level->cellSize), level->tableSize);
+  grid->x[i] = x;
+  grid->y[i] = y;
+  grid->radius[i] = radius;
+  grid->next[i] = level->head[b];
+  level->head[b] = i;
+  level->n++;
+  if (radius > level->maxRadius) level->maxRadius = radius;
+}
+
+int isInsideWorld(World* world, double x, double y, double radius) {
+  return x >= radius && x <= world->width - radius && y >= radius && y <= world->height - radius;
+}
+
+int compareRadiiDescending(const void* a, const void* b) {
+  double ra = *(const double*)a, rb = *(const double*)b;
+  return (ra < rb) - (ra > rb);
+}
+
+int compareRadiiAscending(const void* a, const void* b) {
+  return compareRadiiDescending(b, a);
+}
+
+// Balls from `from` that fit side by side in one row, returns where the row ends and how wide and tall it is
+int lineRowEnd(World* world, double* radii, int from, int n, double* width, double* rowRadius) {
+  int end = from;
+  *width = -SCENE_GAP;
+  *rowRadius = 0;
+  while (end < n && *width + SCENE_GAP + 2 * radii[end] <= world->width) {
+    *width += SCENE_GAP + 2 * radii[end];
+    if (radii[end] > *rowRadius) *rowRadius = radii[end];
+    end++;
+  }
+  return end;
+}
+
+// One row spread evenly across the width like the original line, wrapping into more rows when the balls don't fit, the block of rows centred on mid height
+int placeLine(World* world, PlacementGrid* grid, double* radii, int n) {
+  int fitting = 0;
+  for (int i = 0; i < n; i++) if (2 * radii[i] + SCENE_GAP <= world->width && 2 * radii[i] <= world->height) radii[fitting++] = radii[i];
+
+  double width, rowRadius, blockHeight = -SCENE_GAP;
+  for (int i = 0; i < fitting;) {
+    i = lineRowEnd(world, radii, i, fitting, &width, &rowRadius);
+    blockHeight += 2 * rowRadius + SCENE_GAP;
+  }
+
+  double top = fmax(0, (world->height - blockHeight) / 2);
+  int placed = 0;
+  while (placed < fitting) {
+    int end = lineRowEnd(world, radii, placed, fitting, &width, &rowRadius);
+    if (top + 2 * rowRadius > world->height) break;
+
+    double slack = (world->width - width) / (end - placed + 1);
+    double x = slack;
+    for (; placed < end; placed++) {
+      insertIntoPlacementGrid(grid, placed, x + radii[placed], top + rowRadius, radii[placed]);
+      x += 2 * radii[placed] + SCENE_GAP + slack;
+    }
+    top += 2 * rowRadius + SCENE_GAP;
+  }
+  return placed;
+}
+
+// One hexagonal lattice per band of radii within SCENE_HEX_BAND of each other, spaced for the band's biggest and stacked from the floor up.
+// Smallest band first, so a wide range isn't spent on a screen of big balls. No grid needed since the lattices can't overlap
+int placeHexPacked(World* world, PlacementGrid* grid, double* radii, int n) {
+  qsort(radii, n, sizeof(double), compareRadiiAscending);
+  double bottom = world->height; // where the next band's first row sits
+  int placed = 0;
+
+  for (int start = 0; start < n; start = placed) {
+    int end = start;
+    while (end < n && radii[end] <= radii[start] * SCENE_HEX_BAND) end++;
+    double radius = radii[end - 1];
+    double spacing = 2 * radius + SCENE_GAP;
+    double rowHeight = spacing * sqrt(3) / 2;
+
+    double y = bottom - radius;
+    for (int row = 0; placed < end && y >= radius; row++, y -= rowHeight) {
+      for (double x = radius + (row % 2) * spacing / 2; x <= world->width - radius && placed < end; x += spacing) {
+        insertIntoPlacementGrid(grid, placed, x, y, radii[placed]);
+        placed++;
+      }
+      bottom = y - radius - SCENE_GAP;
+    }
+    if (placed < end) break; // out of height, every band left is bigger
+  }
+  return placed;
+}
+
+// Biggest first, up to SCENE_MAX_ATTEMPTS random spots each, a ball that finds no room is dropped
+int placeRandomWithRejection(World* world, PlacementGrid* grid, double* radii, int n, uint64_t* seed) {
+  qsort(radii, n, sizeof(double), compareRadiiDescending);
+  int placed = 0;
+
+  for (int i = 0; i < n; i++) {
+    for (int attempt = 0; attempt < SCENE_MAX_ATTEMPTS; attempt++) {
+      double x = radii[i] + randomUnit(seed) * (world->width - 2 * radii[i]);
+      double y = radii[i] + randomUnit(seed) * (world->height - 2 * radii[i]);
+      if (!fitsInPlacementGrid(grid, x, y, radii[i])) continue;
+
+      insertIntoPlacementGrid(grid, placed++, x, y, radii[i]);
+      break;
+    }
+  }
+  return placed;
+}
+
+// Up to SCENE_MAX_ATTEMPTS spots just beyond touching distance of a placed ball, returns whether one was free
+int findSpotAround(World* world, PlacementGrid* grid, int from, double radius, uint64_t* seed, double* x, double* y) {
+  for (int attempt = 0; attempt < SCENE_MAX_ATTEMPTS; attempt++) {
+    double touching = grid->radius[from] + radius + SCENE_GAP;
+    double dist = touching * (1 + randomUnit(seed));
+    double angle = 2 * M_PI * randomUnit(seed);
+    *x = grid->x[from] + dist * cos(angle);
+    *y = grid->y[from] + dist * sin(angle);
+    if (isInsideWorld(world, *x, *y, radius) && fitsInPlacementGrid(grid, *x, *y, radius)) return 1;
+  }
+  return 0;
+}
+
+// Bridson's Poisson-disk sampling with per-ball radii: grow outwards from placed balls, biggest first. A placed ball with no room
+// for the current ball but room for the smallest one still to come is parked and comes back once the active ones run out, only a
+// ball the current one finds no room around even then is dropped
+int placePoissonDisk(World* world, PlacementGrid* grid, double* radii, int n, uint64_t* seed) {
+  qsort(radii, n, sizeof(double), compareRadiiDescending);
+  int next = 0;
+  while (next < n && (2 * radii[next] > world->width || 2 * radii[next] > world->height)) next++;
+  if (next == n) return 0;
+
+  int* active = (int*)malloc(n * sizeof(int));
+  int* parked = (int*)malloc(n * sizeof(int));
+  int n_active = 0, n_parked = 0, placed = 0, refilledAt = -1;
+
+  double x = radii[next] + randomUnit(seed) * (world->width - 2 * radii[next]);
+  double y = radii[next] + randomUnit(seed) * (world->height - 2 * radii[next]);
+  insertIntoPlacementGrid(grid, placed, x, y, radii[next++]);
+  active[n_active++] = placed++;
+
+  while (next < n) {
+    if (!n_active) {
+      if (!n_parked) break;
+      if (refilledAt == next) next++; // already tried around every parked ball, this one fits nowhere
+      while (n_parked) active[n_active++] = parked[--n_parked];
+      refilledAt = next;
+      continue;
+    }
+
+    int a = (int)(randomUnit(seed) * n_active);
+    int from = active[a];
+    if (findSpotAround(world, grid, from, radii[next], seed, &x, &y)) {
+      insertIntoPlacementGrid(grid, placed, x, y, radii[next++]);
+      active[n_active++] = placed++;
+      continue;
+    }
+
+    active[a] = active[--n_active];
+    if (radii[next] > radii[n - 1] && findSpotAround(world, grid, from, radii[n - 1], seed, &x, &y)) parked[n_parked++] = from;
+  }
+
+  free(active);
+  free(parked);
+  return placed;
+}
+
+void randomVelocity(Circle* ball, SceneSpec* spec, uint64_t* seed) {
+  switch (spec->velocity) {
+    case VELOCITY_UNIFORM:
+      ball->xvel = (2 * randomUnit(seed) - 1) * spec->speed;
+      ball->yvel = (2 * randomUnit(seed) - 1) * spec->speed;
+      break;
+
+    case VELOCITY_GAUSSIAN:
+      ball->xvel = randomGaussian(seed) * spec->speed;
+      ball->yvel = randomGaussian(seed) * spec->speed;
+      break;
+
+    default:
+      ball->xvel = 0;
+      ball->yvel = 0;
+      break;
+  }
+}
+
+// Balls the scene couldn't fit are left out, world->n says how many made it
+World* createScene(WorldParams params, int width, int height, SceneSpec* spec) {
+  World* world = (World*)malloc(sizeof(World));
+  world->params = params;
+  world->width = width;
+  world->height = height;
+  world->hash = createSpatialHash();
+
+  // Log-uniform radii have no range down to 0 or below (pow() turns them into NaN), a spec like that builds an empty world
+  int n = spec->n > 0 && spec->minRadius > 0 && spec->maxRadius >= spec->minRadius && isfinite(spec->maxRadius) ? spec->n : 0;
+
+  // Log-uniform radii, so a 2-200 px range gets as many balls per decade instead of being all big ones
+  uint64_t seed = spec->seed;
+  double* radii = (double*)malloc((n ? n : 1) * sizeof(double));
+  for (int i = 0; i < n; i++) radii[i] = spec->minRadius * pow(spec->maxRadius / spec->minRadius, randomUnit(&seed));
+
+  PlacementGrid* grid = createPlacementGrid(radii, n);
+  int placed = 0;
+  switch (spec->layout) {
+    case SCENE_LINE:
+      placed = placeLine(world, grid, radii, n);
+      break;
+
+    case SCENE_HEX:
+      placed = placeHexPacked(world, grid, radii, n);
+      break;
+
+    case SCENE_POISSON:
+      placed = placePoissonDisk(world, grid, radii, n, &seed);
+      break;
+
+    default:
+      placed = placeRandomWithRejection(world, grid, radii, n, &seed);
+      break;
+  }
+
+  world->n = placed;
+  world->balls = (Circle**)malloc((placed ? placed : 1) * sizeof(Circle*));
+  for (int i = 0; i < placed; i++) {
+    world->balls[i] = createBall(createPoint(grid->x[i], grid->y[i]), grid->radius[i], 0, 0, 0);
+    randomVelocity(world->balls[i], spec, &seed);
+  }
+
+  deletePlacementGrid(grid);
+  free(radii);
+  return world;
+}
+
+// EVENT-DRIVEN ENGINE: BETWEEN IMPACTS EVERY BALL IS IN PURE BALLISTIC MOTION, SO INSTEAD OF STEPPING IT EVERY FRAME WE SOLVE FOR THE NEXT IMPACT AND JUMP STRAIGHT TO IT
+// Time is counted in frames, one unit is one step of the fixed-step loop, so velocities keep their px/frame meaning
+
+int isEventValid(Event* e) {
+  if (e->countA != e->a->nEvents) return 0;
+  if (e->b && e->countB != e->b->nEvents) return 0;
+  return 1;
+}
+
+void siftEventDown(EventEngine* engine, int i) {
+  Event* heap = engine->heap;
+  while (1) {
+    int l = 2 * i + 1, r = l + 1, min = i;
+    if (l < engine->n_events && heap[l].t < heap[min].t) min = l;
+    if (r < engine->n_events && heap[r].t < heap[min].t) min = r;
+    if (min == i) return;
+
+    Event temp = heap[i];
+    heap[i] = heap[min];
+    heap[min] = temp;
+    i = min;
+  }
+}
+
+// Drop every stale event and rebuild the heap, keeps the queue from bloating with invalidated predictions
+void compactEvents(EventEngine* engine) {
+  int k = 0;
+  for (int i = 0; i < engine->n_events; i++) if (isEventValid(&engine->heap[i])) engine->heap[k++] = engine->heap[i];
+  engine->n_events = k;
+  for (int i = k / 2 - 1; i >= 0; i--) siftEventDown(engine, i);
+}
+
+void pushEvent(EventEngine* engine, double t, EventType type, Circle* a, Circle* b) {
+  if (engine->n_events == engine->capacity) {
+    compactEvents(engine);
+    if (engine->n_events > engine->capacity / 2) {
+      engine->capacity *= 2;
+      engine->heap = (Event*)realloc(engine->heap, engine->capacity * sizeof(Event));
+    }
+  }
+
+  Event e = {t, type, a, b, a->nEvents, b ? b->nEvents : 0};
+  int i = engine->n_events++;
+  while (i > 0 && engine->heap[(i - 1) / 2].t > t) {
+    engine->heap[i] = engine->heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  engine->heap[i] = e;
+}
+
+Event popEvent(EventEngine* engine) {
+  Event top = engine->heap[0];
+  engine->heap[0] = engine->heap[--engine->n_events];
+  siftEventDown(engine, 0);
+  return top;
+}
+
+int isBallGrounded(World* world, Circle* ball) {
+  return ball->restingOn || (ball->yvel == 0 && ball->coords->y >= world->height - ball->radius);
+}
+
+int isBallStill(World* world, Circle* ball) {
+  return ball->xvel == 0 && isBallGrounded(world, ball);
+}
+
+// Where the ball is dt frames after ball->t, a grounded ball rolls with xvel shrinking by inverseFrictionCoeff every frame, summed up in closed form
+void ballStateAt(World* world, Circle* ball, double dt, double* x, double* y, double* xvel, double* yvel) {
+  *x = ball->coords->x;
+  *y = ball->coords->y;
+  *xvel = ball->xvel;
+  *yvel = ball->yvel;
+  if (ball->isInteracted || dt <= 0) return;
+
+  if (isBallGrounded(world, ball)) {
+    if (*xvel == 0) return; // resting
+    double lnF = log(world->params.inverseFrictionCoeff);
+    double decay = exp(lnF * dt);
+    *x += lnF == 0 ? *xvel * dt : *xvel * (decay - 1) / lnF;
+    *xvel *= decay;
+    return;
+  }
+
+  double g = world->params.gravity;
+  *x += *xvel * dt;
+  *y += *yvel * dt + 0.5 * g * dt * dt;
+  *yvel += g * dt;
+}
+
+// Move the ball along its parabola (or rolling decay) up to time t, a held ball stays wherever the mouse put it
+void driftBall(World* world, Circle* ball, double t) {
+  double dt = t - ball->t;
+  ball->t = t;
+  ballStateAt(world, ball, dt, &ball->coords->x, &ball->coords->y, &ball->xvel, &ball->yvel);
+}
+
+// Time until the ball has moved d along x, 0 if it is already past, INFINITY if rolling friction stops it short
+double timeToMoveX(World* world, Circle* ball, double d) {
+  if (ball->xvel == 0) return INFINITY;
+  if (d / ball->xvel <= 0) return 0;
+  if (!isBallGrounded(world, ball)) return d / ball->xvel;
+
+  // x(t) = x + xvel * (f^t - 1) / ln f, solved for f^t
+  double lnF = log(world->params.inverseFrictionCoeff);
+  if (lnF == 0) return d / ball->xvel;
+  double decay = 1 + d * lnF / ball->xvel;
+  return decay > 0 ? log(decay) / lnF : INFINITY;
+}
+
+// Time until a flying ball has climbed d px, smaller root of 0.5*g*t^2 + vy*t + d = 0, INFINITY if it turns around first
+double timeToRise(World* world, double vy, double d) {
+  if (vy >= 0) return INFINITY;
+  if (d <= 0) return 0;
+
+  double g = world->params.gravity;
+  if (g == 0) return d / -vy; // without gravity the ball just keeps going straight
+
+  double disc = vy * vy - 2 * g * d;
+  if (disc < 0) return INFINITY;
+  return (-vy - sqrt(disc)) / g;
+}
+
+// Time until a flying ball has dropped d px, larger root of 0.5*g*t^2 + vy*t - d = 0, a ball on its way up comes back down
+double timeToFall(World* world, double vy, double d) {
+  double g = world->params.gravity;
+  if (g == 0) return vy > 0 ? fmax(0, d / vy) : INFINITY; // a ball on its way up never comes back down
+
+  double disc = vy * vy + 2 * g * d;
+  return fmax(0, (-vy + sqrt(fmax(0, disc))) / g);
+}
+
+double timeToWallX(World* world, Circle* ball) {
+  if (ball->xvel > 0) return timeToMoveX(world, ball, world->width - ball->radius - ball->coords->x);
+  if (ball->xvel < 0) return timeToMoveX(world, ball, ball->radius - ball->coords->x);
+  return INFINITY;
+}
+
+double timeToWallY(World* world, Circle* ball) {
+  if (isBallGrounded(world, ball)) return INFINITY;
+
+  // Ceiling can only be reached on the way up, floor is always reached eventually
+  double t = timeToRise(world, ball->yvel, ball->coords->y - ball->radius);
+  if (isfinite(t)) return t;
+  return timeToFall(world, ball->yvel, world->height - ball->radius - ball->coords->y);
+}
+
+// A rolling ball never quite stops under geometric decay, so it gets one event for when it drops below MIN_ROLLING_XVEL
+double timeToRest(World* world, Circle* ball) {
+  if (!isBallGrounded(world, ball) || ball->xvel == 0) return INFINITY;
+  if (fabs(ball->xvel) < MIN_ROLLING_XVEL) return 0;
+
+  double lnF = log(world->params.inverseFrictionCoeff);
+  return lnF < 0 ? log(MIN_ROLLING_XVEL / fabs(ball->xvel)) / lnF : INFINITY;
+}
+
+// Time until the ball changes velocity on its own, without any other ball involved
+double timeToOwnEvent(World* world, Circle* ball) {
+  return fmin(fmin(timeToWallX(world, ball), timeToWallY(world, ball)), timeToRest(world, ball));
+}
+
+// Time until the ball crosses an edge of its grid cell, stepX/stepY (if given) say which neighbouring cell it crosses into, the outer cells stretch out to infinity
+double timeToCellEdge(EventEngine* engine, Circle* ball, int* stepX, int* stepY) {
+  World* world = engine->world;
+  double left = ball->cellX * engine->cellSize, top = ball->cellY * engine->cellSize;
+  double t = INFINITY, edge;
+  int sx = 0, sy = 0;
+
+  if (ball->xvel < 0 && ball->cellX > 0) {
+    t = timeToMoveX(world, ball, left - ball->coords->x);
+    sx = -1;
+  } else if (ball->xvel > 0 && ball->cellX < engine->cols - 1) {
+    t = timeToMoveX(world, ball, left + engine->cellSize - ball->coords->x);
+    sx = 1;
+  }
+  if (!isfinite(t)) sx = 0;
+
+  if (!isBallGrounded(world, ball)) {
+    edge = ball->cellY > 0 ? timeToRise(world, ball->yvel, ball->coords->y - top) : INFINITY;
+    if (edge < t) {
+      t = edge;
+      sx = 0;
+      sy = -1;
+    }
+
+    edge = ball->cellY < engine->rows - 1 ? timeToFall(world, ball->yvel, top + engine->cellSize - ball->coords->y) : INFINITY;
+    if (edge < t) {
+      t = edge;
+      sx = 0;
+      sy = 1;
+    }
+  }
+
+  if (stepX) *stepX = sx;
+  if (stepY) *stepY = sy;
+  return t;
+}
+
+// Closing faster than TOI_EPSILON along the line between the centres, slower counts as resting contact so rounding can't
+// send a pair that just collided into another collision at the same instant
+int isApproaching(double dx, double dy, double dvx, double dvy) {
+  return dx * dvx + dy * dvy < -TOI_EPSILON * sqrt(dx * dx + dy * dy);
+}
+
+// Contact time of two balls moving in straight lines relative to each other, smaller root written so it doesn't cancel out
+double timeToTouch(double dx, double dy, double dvx, double dvy, double rad_dist) {
+  if (!isApproaching(dx, dy, dvx, dvy)) return INFINITY;
+  double dvdr = dx * dvx + dy * dvy;
+
+  double dvdv = dvx * dvx + dvy * dvy;
+  double drdr = dx * dx + dy * dy - rad_dist * rad_dist;
+  if (drdr <= 0) return 0; // already overlapping and still approaching
+
+  double disc = dvdr * dvdr - dvdv * drdr;
+  if (disc < 0) return INFINITY;
+  return drdr / (-dvdr + sqrt(disc));
+}
+
+// Both balls must already be drifted to the same time, returns time from then until they touch
+double timeToHit(World* world, Circle* ball1, Circle* ball2) {
+  int grounded1 = isBallGrounded(world, ball1);
+  int grounded2 = isBallGrounded(world, ball2);
+  double rad_dist = ball1->radius + ball2->radius;
+
+  // Gravity cancels out when both are flying, relative motion is a straight line. Both grounded roll with the same decay, so
+  // both positions are linear in s = (f^t - 1) / ln f instead, solve for s the same way and turn it back into time
+  if (grounded1 == grounded2) {
+    double t = timeToTouch(ball2->coords->x - ball1->coords->x, ball2->coords->y - ball1->coords->y, ball2->xvel - ball1->xvel, ball2->yvel - ball1->yvel, rad_dist);
+    double lnF = log(world->params.inverseFrictionCoeff);
+    if (!grounded1 || !isfinite(t) || lnF == 0) return t;
+
+    double decay = 1 + t * lnF;
+    return decay > 0 ? log(decay) / lnF : INFINITY;
+  }
+
+  // One grounded and one flying makes the distance a quartic, conservative advancement until either ball's own next event (after which the pair gets predicted again anyway)
+  double horizon = fmin(timeToOwnEvent(world, ball1), timeToOwnEvent(world, ball2));
+  if (!isfinite(horizon)) return INFINITY;
+
+  double lnF = log(world->params.inverseFrictionCoeff);
+  double t = 0;
+  for (int i = 0; i < TOI_MAX_ITERATIONS && t < horizon; i++) {
+    double x1, y1, vx1, vy1, x2, y2, vx2, vy2;
+    ballStateAt(world, ball1, t, &x1, &y1, &vx1, &vy1);
+    ballStateAt(world, ball2, t, &x2, &y2, &vx2, &vy2);
+    double px = x2 - x1, py = y2 - y1;
+    double gap = sqrt(px * px + py * py) - rad_dist;
+    if (gap <= TOI_EPSILON && isApproaching(px, py, vx2 - vx1, vy2 - vy1)) return t;
+
+    // Neither ball can move faster than this before the horizon, so moving by gap / speed while they close in never steps past contact
+    double rolling = grounded1 ? fabs(vx1) : fabs(vx2);
+    double flyingVx = grounded1 ? vx2 : vx1, flyingVy = grounded1 ? vy2 : vy1;
+    double speedBound = rolling * fmax(1, exp(lnF * (horizon - t))) + sqrt(flyingVx * flyingVx + flyingVy * flyingVy) + fabs(world->params.gravity) * (horizon - t);
+
+    // Close but not closing in, gap / speed would crawl forever while gravity may still turn them around, so they move up to
+    // TOI_CONTACT_STEP of the radii between checks instead and can end up overlapping by at most that much
+    if (isApproaching(px, py, vx2 - vx1, vy2 - vy1)) t += gap / speedBound;
+    else t += fmax(gap, TOI_CONTACT_STEP * rad_dist) / speedBound;
+  }
+
+  return t < horizon ? t : INFINITY; // out of iterations returns a check-up time, resolveEvent just predicts the pair again if they aren't touching
+}
+
+void bounceOffWallX(World* world, Circle* ball) {
+  if (fabs(ball->xvel) <= world->params.minXvel) ball->xvel = 0;
+  else ball->xvel = (-1) * (ball->xvel * world->params.xDampCoeff);
+
+  if (ball->coords->x >= world->width / 2.0) ball->coords->x = world->width - ball->radius;
+  else ball->coords->x = ball->radius;
+}
+
+void bounceOffWallY(World* world, Circle* ball) {
+  if (ball->coords->y >= world->height / 2.0) ball->coords->y = world->height - ball->radius;
+  else ball->coords->y = ball->radius;
+
+  if (fabs(ball->yvel) <= world->params.minYvel) ball->yvel = 0;
+  else ball->yvel = (-1) * (ball->yvel * world->params.yDampCoeff);
+
+  ball->xvel = (ball->xvel * world->params.inverseFrictionCoeff);
+}
+
+// A collision may shove a ball into a wall or point it outwards while touching one. A ball lying on the floor isn't bounced again,
+// that would take rolling friction off it once per collision and leave the pair approaching again
+void settleAgainstWalls(World* world, Circle* ball) {
+  if ((ball->coords->x >= world->width - ball->radius && ball->xvel >= 0) || (ball->coords->x <= ball->radius && ball->xvel <= 0)) bounceOffWallX(world, ball);
+  if ((ball->coords->y >= world->height - ball->radius && ball->yvel > 0) || (ball->coords->y <= ball->radius && ball->yvel < 0)) bounceOffWallY(world, ball);
+}
+
+// Whether a wall stops the ball from moving any further along (dx, dy)
+int isPinnedX(World* world, Circle* ball, double dx) {
+  return (dx > 0 && ball->coords->x >= world->width - ball->radius - TOI_EPSILON) || (dx < 0 && ball->coords->x <= ball->radius + TOI_EPSILON);
+}
+
+int isPinnedY(World* world, Circle* ball, double dy) {
+  return (dy > 0 && ball->coords->y >= world->height - ball->radius - TOI_EPSILON) || (dy < 0 && ball->coords->y <= ball->radius + TOI_EPSILON);
+}
+
+// collisionTrajectory() for the event engine, n points from ball1 to ball2 and masses go with the radii the same way. A ball pressed
+// into a wall can't give way along that axis, so the wall takes that part of the impulse as if the ball were infinitely heavy there,
+// otherwise settleAgainstWalls() throws its new velocity away and the pair is still approaching at the same instant. Impacts slower
+// than MIN_BOUNCE_SPEED don't bounce, so a row of touching balls comes to rest instead of rattling at ever shorter intervals
+void collideBalls(World* world, Circle* ball1, Circle* ball2, double nx, double ny) {
+  double mx1 = isPinnedX(world, ball1, -nx) ? 0 : nx, my1 = isPinnedY(world, ball1, -ny) ? 0 : ny;
+  double mx2 = isPinnedX(world, ball2, nx) ? 0 : nx, my2 = isPinnedY(world, ball2, ny) ? 0 : ny;
+  double w1 = (mx1 * nx + my1 * ny) / ball1->radius;
+  double w2 = (mx2 * nx + my2 * ny) / ball2->radius;
+  if (w1 + w2 <= 0) return; // wedged between walls, neither can move
+
+  double dx = ball2->coords->x - ball1->coords->x;
+  double dy = ball2->coords->y - ball1->coords->y;
+  double overlap = ball1->radius + ball2->radius - sqrt(dx * dx + dy * dy);
+  if (overlap > 0) {
+    ball1->coords->x -= overlap * w1 / (w1 + w2) * mx1;
+    ball1->coords->y -= overlap * w1 / (w1 + w2) * my1;
+    ball2->coords->x += overlap * w2 / (w1 + w2) * mx2;
+    ball2->coords->y += overlap * w2 / (w1 + w2) * my2;
+  }
+
+  double approach = (ball2->xvel - ball1->xvel) * nx + (ball2->yvel - ball1->yvel) * ny;
+  if (approach >= 0) return;
+
+  double restitution = approach < -MIN_BOUNCE_SPEED ? world->params.coeffOfRestitution : 0;
+  double impulse = -(1 + restitution) * approach / (w1 + w2);
+  ball1->xvel -= impulse * mx1 / ball1->radius;
+  ball1->yvel -= impulse * my1 / ball1->radius;
+  ball2->xvel += impulse * mx2 / ball2->radius;
+  ball2->yvel += impulse * my2 / ball2->radius;
+}
+
+void linkIntoCell(EventEngine* engine, Circle* ball, int cx, int cy) {
+  Circle** head = &engine->cells[cy * engine->cols + cx];
+  ball->cellX = cx;
+  ball->cellY = cy;
+  ball->prevInCell = NULL;
+  ball->nextInCell = *head;
+  if (*head) (*head)->prevInCell = ball;
+  *head = ball;
+}
+
+void unlinkFromCell(EventEngine* engine, Circle* ball) {
+  if (ball->prevInCell) ball->prevInCell->nextInCell = ball->nextInCell;
+  else engine->cells[ball->cellY * engine->cols + ball->cellX] = ball->nextInCell;
+  if (ball->nextInCell) ball->nextInCell->prevInCell = ball->prevInCell;
+}
+
+// Cell from the ball's position, anything off the world goes in the outer cells
+void linkByPosition(EventEngine* engine, Circle* ball) {
+  int cx = cellOf(ball->coords->x, engine->cellSize);
+  int cy = cellOf(ball->coords->y, engine->cellSize);
+  linkIntoCell(engine, ball, cx < 0 ? 0 : (cx >= engine->cols ? engine->cols - 1 : cx), cy < 0 ? 0 : (cy >= engine->rows ? engine->rows - 1 : cy));
+}
+
+// Pushing overlapping balls apart moves them without a crossing event, so a ball can end up outside its cell
+void relinkByPosition(EventEngine* engine, Circle* ball) {
+  unlinkFromCell(engine, ball);
+  linkByPosition(engine, ball);
+}
+
+// A ball coming out of a collision with a still ball under it at almost no speed is laid to rest on it, otherwise it would
+// bounce on it at ever shorter intervals. Lying on one ball at a slant it keeps sliding faster than this, so only a ball on top settles
+void restOnSupport(World* world, Circle* ball, Circle* support) {
+  if (support->coords->y <= ball->coords->y || !isBallStill(world, support)) return;
+  if (ball->xvel * ball->xvel + ball->yvel * ball->yvel > MIN_ROLLING_XVEL * MIN_ROLLING_XVEL) return;
+
+  ball->xvel = 0;
+  ball->yvel = 0;
+  ball->restingOn = support;
+}
+
+void predictBall(EventEngine* engine, Circle* ball, Circle* skip);
+
+// The ball is about to move, so whatever lies on it falls again, and whatever lies on those
+void wakeRestingOn(EventEngine* engine, Circle* ball) {
+  for (int cx = ball->cellX - 1; cx <= ball->cellX + 1; cx++) {
+    for (int cy = ball->cellY - 1; cy <= ball->cellY + 1; cy++) {
+      if (cx < 0 || cy < 0 || cx >= engine->cols || cy >= engine->rows) continue;
+      for (Circle* other = engine->cells[cy * engine->cols + cx]; other; other = other->nextInCell) {
+        if (other->restingOn != ball) continue;
+        driftBall(engine->world, other, engine->now);
+        other->restingOn = NULL;
+        other->nEvents++;
+        wakeRestingOn(engine, other);
+        predictBall(engine, other, NULL);
+      }
+    }
+  }
+}
+
+int isOnFloor(World* world, Circle* ball) {
+  return !ball->restingOn && isBallGrounded(world, ball);
+}
+
+// Nearest ball on the floor touching this one from the left (dir -1) or right (dir 1)
+Circle* floorNeighbour(EventEngine* engine, Circle* ball, int dir) {
+  World* world = engine->world;
+  Circle* nearest = NULL;
+  for (int cx = ball->cellX - 1; cx <= ball->cellX + 1; cx++) {
+    for (int cy = ball->cellY - 1; cy <= ball->cellY + 1; cy++) {
+      if (cx < 0 || cy < 0 || cx >= engine->cols || cy >= engine->rows) continue;
+      for (Circle* other = engine->cells[cy * engine->cols + cx]; other; other = other->nextInCell) {
+        if (other == ball || other->isInteracted || !isOnFloor(world, other)) continue;
+        driftBall(world, other, engine->now);
+        double dx = other->coords->x - ball->coords->x, dy = other->coords->y - ball->coords->y;
+        if (dx * dir <= 0) continue;
+        if (sqrt(dx * dx + dy * dy) > ball->radius + other->radius + TOI_EPSILON) continue;
+        if (!nearest || fabs(dx) < fabs(nearest->coords->x - ball->coords->x)) nearest = other;
+      }
+    }
+  }
+  return nearest;
+}
+
+// A slow contact between two balls rolling on the floor settles the whole row of touching balls at once. With no bounce, runs that
+// push into each other end up rolling together at their momentum weighted speed (pool adjacent violators), pairwise collisions only
+// get there after endlessly many ever smaller ones. Masses go with the radii like collisionTrajectory()
+void settleFloorRow(EventEngine* engine, Circle* ball1, Circle* ball2) {
+  World* world = engine->world;
+  Circle** row = engine->row;
+  int n = 0;
+
+  // Collected leftwards first, then flipped into left to right order
+  for (Circle* ball = ball1->coords->x <= ball2->coords->x ? ball1 : ball2; ball && n < world->n; ball = floorNeighbour(engine, ball, -1)) row[n++] = ball;
+  for (int i = 0; i < n / 2; i++) {
+    Circle* temp = row[i];
+    row[i] = row[n - 1 - i];
+    row[n - 1 - i] = temp;
+  }
+  for (Circle* ball = floorNeighbour(engine, row[n - 1], 1); ball && n < world->n; ball = floorNeighbour(engine, ball, 1)) row[n++] = ball;
+
+  RowBlock* blocks = engine->blocks;
+  int n_blocks = 0;
+  for (int i = 0; i < n; i++) {
+    blocks[n_blocks++] = (RowBlock){ row[i]->radius, row[i]->xvel, i + 1 };
+    while (n_blocks > 1 && blocks[n_blocks - 2].xvel > blocks[n_blocks - 1].xvel) {
+      RowBlock* left = &blocks[n_blocks - 2];
+      RowBlock* right = &blocks[n_blocks - 1];
+      left->xvel = (left->xvel * left->mass + right->xvel * right->mass) / (left->mass + right->mass);
+      left->mass += right->mass;
+      left->end = right->end;
+      n_blocks--;
+    }
+  }
+
+  // Only balls whose speed changed are predicted again, the rest still have their events (cell crossings included, which never go stale)
+  int changed = 0, i = 0;
+  for (int b = 0; b < n_blocks; b++) {
+    for (; i < blocks[b].end; i++) {
+      if (row[i]->xvel == blocks[b].xvel) continue;
+      row[i]->xvel = blocks[b].xvel;
+      row[i]->nEvents++;
+      row[changed++] = row[i];
+    }
+  }
+  for (i = 0; i < changed; i++) {
+    if (!isBallStill(world, row[i])) wakeRestingOn(engine, row[i]);
+    predictBall(engine, row[i], NULL);
+  }
+}
+
+void predictPair(EventEngine* engine, Circle* ball1, Circle* ball2) {
+  driftBall(engine->world, ball2, engine->now);
+  double t = timeToHit(engine->world, ball1, ball2);
+  if (isfinite(t)) pushEvent(engine, engine->now + t, EVENT_BALL, ball1, ball2);
+}
+
+void predictAgainstCell(EventEngine* engine, Circle* ball, Circle* skip, int cx, int cy) {
+  if (cx < 0 || cy < 0 || cx >= engine->cols || cy >= engine->rows) return;
+  for (Circle* other = engine->cells[cy * engine->cols + cx]; other; other = other->nextInCell) {
+    if (other != ball && other != skip && !other->isInteracted) predictPair(engine, ball, other);
+  }
+}
+
+void predictCellEvent(EventEngine* engine, Circle* ball) {
+  double t = timeToCellEdge(engine, ball, NULL, NULL);
+  if (isfinite(t)) pushEvent(engine, engine->now + t, EVENT_CELL, ball, NULL);
+}
+
+void predictOwnEvents(EventEngine* engine, Circle* ball) {
+  World* world = engine->world;
+  double t = timeToWallX(world, ball);
+  if (isfinite(t)) pushEvent(engine, engine->now + t, EVENT_WALL_X, ball, NULL);
+  t = timeToWallY(world, ball);
+  if (isfinite(t)) pushEvent(engine, engine->now + t, EVENT_WALL_Y, ball, NULL);
+  t = timeToRest(world, ball);
+  if (isfinite(t)) pushEvent(engine, engine->now + t, EVENT_REST, ball, NULL);
+  predictCellEvent(engine, ball);
+}
+
+// Schedule everything that can happen to the ball next, skip is the other ball of a collision and is predicted on its own
+void predictBall(EventEngine* engine, Circle* ball, Circle* skip) {
+  if (ball->isInteracted) return;
+  driftBall(engine->world, ball, engine->now);
+  predictOwnEvents(engine, ball);
+
+  for (int cx = ball->cellX - 1; cx <= ball->cellX + 1; cx++) {
+    for (int cy = ball->cellY - 1; cy <= ball->cellY + 1; cy++) predictAgainstCell(engine, ball, skip, cx, cy);
+  }
+}
+
+// The ball moved one cell over without changing course, only balls around the new cell that weren't around the old one are new
+void crossCellEdge(EventEngine* engine, Circle* ball) {
+  int oldX = ball->cellX, oldY = ball->cellY, stepX, stepY;
+  timeToCellEdge(engine, ball, &stepX, &stepY);
+  unlinkFromCell(engine, ball);
+  linkIntoCell(engine, ball, oldX + stepX, oldY + stepY);
+
+  for (int cx = ball->cellX - 1; cx <= ball->cellX + 1; cx++) {
+    for (int cy = ball->cellY - 1; cy <= ball->cellY + 1; cy++) {
+      if (abs(cx - oldX) > 1 || abs(cy - oldY) > 1) predictAgainstCell(engine, ball, NULL, cx, cy);
+    }
+  }
+  predictCellEvent(engine, ball);
+}
+
+void resolveEvent(EventEngine* engine, Event* e) {
+  World* world = engine->world;
+  Circle* ball1 = e->a;
+  Circle* ball2 = e->b;
+  driftBall(world, ball1, engine->now);
+
+  switch (e->type) {
+    case EVENT_WALL_X:
+      bounceOffWallX(world, ball1);
+      break;
+
+    case EVENT_WALL_Y:
+      bounceOffWallY(world, ball1);
+      break;
+
+    case EVENT_REST:
+      ball1->xvel = 0;
+      break;
+
+    case EVENT_CELL: // Course is unchanged, so nothing already predicted for the ball goes stale
+      crossCellEdge(engine, ball1);
+      return;
+
+    case EVENT_BALL: {
+      driftBall(world, ball2, engine->now);
+      double dx = ball2->coords->x - ball1->coords->x;
+      double dy = ball2->coords->y - ball1->coords->y;
+      double distance = sqrt(dx * dx + dy * dy);
+      int touching = distance <= ball1->radius + ball2->radius + TOI_EPSILON;
+      int approaching = isApproaching(dx, dy, ball2->xvel - ball1->xvel, ball2->yvel - ball1->yvel);
+      if (!touching || !approaching) { // only a check-up from conservative advancement
+        predictPair(engine, ball1, ball2);
+        return;
+      }
+
+      if (isOnFloor(world, ball1) && isOnFloor(world, ball2) && isApproaching(dx, 0, ball2->xvel - ball1->xvel, 0) && fabs(ball2->xvel - ball1->xvel) < MIN_BOUNCE_SPEED) {
+        settleFloorRow(engine, ball1, ball2);
+        return;
+      }
+
+      ball1->restingOn = NULL;
+      ball2->restingOn = NULL;
+      collideBalls(world, ball1, ball2, dx / distance, dy / distance);
+      settleAgainstWalls(world, ball1);
+      settleAgainstWalls(world, ball2);
+      restOnSupport(world, ball1, ball2);
+      restOnSupport(world, ball2, ball1);
+      break;
+    }
+  }
+
+  ball1->nEvents++;
+  relinkByPosition(engine, ball1);
+  if (ball2) {
+    ball2->nEvents++;
+    relinkByPosition(engine, ball2);
+  }
+  if (!isBallStill(world, ball1)) wakeRestingOn(engine, ball1);
+  if (ball2 && !isBallStill(world, ball2)) wakeRestingOn(engine, ball2);
+  predictBall(engine, ball1, ball2);
+  if (ball2) predictBall(engine, ball2, NULL);
+}
+
+// Throw the whole queue and grid away and predict from scratch, balls must all be synced to engine->now
+void predictAllBalls(EventEngine* engine) {
+  World* world = engine->world;
+  Circle** balls = world->balls;
+  engine->n_events = 0;
+  memset(engine->cells, 0, engine->cols * engine->rows * sizeof(Circle*));
+
+  // Every pair once, each ball is predicted only against the balls linked into the grid before it
+  for (int i = 0; i < world->n; i++) {
+    Circle* ball = balls[i];
+    ball->t = engine->now;
+    ball->nEvents = 0;
+    ball->restingOn = NULL;
+    linkByPosition(engine, ball);
+    if (ball->isInteracted) continue;
+
+    predictOwnEvents(engine, ball);
+    for (int cx = ball->cellX - 1; cx <= ball->cellX + 1; cx++) {
+      for (int cy = ball->cellY - 1; cy <= ball->cellY + 1; cy++) predictAgainstCell(engine, ball, NULL, cx, cy);
+    }
+  }
+}
+
+EventEngine* createEventEngine(World* world) {
+  EventEngine* engine = (EventEngine*)malloc(sizeof(EventEngine));
+  engine->capacity = EVENT_QUEUE_CAPACITY;
+  engine->heap = (Event*)malloc(engine->capacity * sizeof(Event));
+  engine->n_events = 0;
+  engine->now = 0;
+  engine->world = world;
+  engine->stepFrames = 0;
+  engine->backoff = 1;
+
+  // Cells fit the biggest ball, but no more than ENGINE_CELLS_PER_BALL of them so sparse worlds don't get huge grids
+  double maxRadius = 0;
+  for (int i = 0; i < world->n; i++) maxRadius = fmax(maxRadius, world->balls[i]->radius);
+  engine->cellSize = fmax(2 * maxRadius + TOI_EPSILON, sqrt((double)world->width * world->height / (ENGINE_CELLS_PER_BALL * (world->n ? world->n : 1))));
+  engine->cols = (int)(world->width / engine->cellSize) + 1;
+  engine->rows = (int)(world->height / engine->cellSize) + 1;
+  engine->cells = (Circle**)calloc(engine->cols * engine->rows, sizeof(Circle*));
+  engine->row = (Circle**)malloc((world->n ? world->n : 1) * sizeof(Circle*));
+  engine->blocks = (RowBlock*)malloc((world->n ? world->n : 1) * sizeof(RowBlock));
+
+  predictAllBalls(engine);
+  return engine;
+}
+
+// Jump from event to event up to dt frames ahead, then sample every ball at that time for drawing
+void advanceEventEngine(EventEngine* engine, double dt) {
+  World* world = engine->world;
+  double target = engine->now + dt;
+
+  // Still stepping through a collapse, try events again once the backoff is over
+  if (engine->stepFrames > 0) {
+    int frames = (int)ceil(dt);
+    for (int i = 0; i < frames; i++) stepWorld(world);
+    engine->now = target;
+    for (int i = 0; i < world->n; i++) world->balls[i]->t = engine->now; // stepWorld() moved them, don't let driftBall() move them again
+    engine->stepFrames -= frames;
+    if (engine->stepFrames <= 0) predictAllBalls(engine);
+    return;
+  }
+
+  // Budget is per frame of simulated time, so a collapse is caught just as early when many frames are advanced at once
+  int budget = MAX_EVENTS_PER_BALL_PER_FRAME * world->n + 1;
+  int left = budget;
+  double budgetEnd = engine->now + 1;
+  int overBudget = 0;
+
+  while (engine->n_events && engine->heap[0].t <= target) {
+    Event e = popEvent(engine);
+    if (!isEventValid(&e)) continue;
+    if (e.t > budgetEnd) {
+      left = budget;
+      budgetEnd = e.t + 1;
+    }
+    if (e.type != EVENT_CELL && !left--) { // cell crossings are bookkeeping, only real impacts hint at a collapsing pile
+      overBudget = 1;
+      break;
+    }
+
+    engine->now = fmax(engine->now, e.t);
+    resolveEvent(engine, &e);
+  }
+
+  // Piles and resting stacks collide endlessly at ever shorter intervals (inelastic collapse), finish such a call with regular steps
+  // and keep stepping for a while, twice as long every time the pile is still there when events are tried again
+  if (overBudget) {
+    for (int i = 0; i < world->n; i++) driftBall(world, world->balls[i], engine->now);
+    for (int frames = (int)ceil(target - engine->now); frames > 0; frames--) stepWorld(world);
+    engine->now = target;
+    for (int i = 0; i < world->n; i++) world->balls[i]->t = engine->now;
+    engine->stepFrames = engine->backoff;
+    engine->backoff = engine->backoff * 2 > ENGINE_MAX_BACKOFF ? ENGINE_MAX_BACKOFF : engine->backoff * 2;
+    return;
+  }
+  if (engine->backoff > 1) engine->backoff /= 2;
+
+  engine->now = target;
+  for (int i = 0; i < world->n; i++) driftBall(world, world->balls[i], engine->now);
+}
+
+// The mouse moved the ball or changed its velocity, so everything predicted for it is wrong
+void touchBall(EventEngine* engine, Circle* ball) {
+  ball->t = engine->now;
+  if (engine->stepFrames > 0) return; // stepping through a collapse, predictAllBalls() picks it up once events are tried again
+  ball->nEvents++;
+  ball->restingOn = NULL;
+  wakeRestingOn(engine, ball);
+  relinkByPosition(engine, ball);
+  predictBall(engine, ball, NULL);
+}
+
+void deleteEventEngine(EventEngine* engine) {
+  free(engine->row);
+  free(engine->blocks);
+  free(engine->cells);
+  free(engine->heap);
+  free(engine);
+}
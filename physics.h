@@ -0,0 +1,193 @@
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include <stdint.h>
+
+// Defaults for WorldParams, tune per world through the struct instead of rebuilding
+#define RADIUS 50
+#define GRAVITY 0.2
+#define INVERSE_FRICTION_COEFF 0.996
+#define X_DAMP_COEFF 0.95
+#define Y_DAMP_COEFF 0.8
+#define MIN_YVEL 1
+#define MIN_XVEL 1
+#define COEFF_OF_RESTITUTION 0.8
+#define PATH_TRACE_LENGTH 30
+#define EVENT_QUEUE_CAPACITY 1024
+#define MAX_EVENTS_PER_BALL_PER_FRAME 4
+#define ENGINE_MAX_BACKOFF 256 // most frames the event engine hands to the fixed step after a collapse before trying events again
+#define ENGINE_CELLS_PER_BALL 16 // cap on event engine grid cells, a few balls per 3x3 neighbourhood even when they gather on the floor
+#define MIN_ROLLING_XVEL 0.01
+#define MIN_BOUNCE_SPEED 0.1 // event engine impacts slower than this don't bounce, touching balls would collide endlessly otherwise (inelastic collapse)
+#define TOI_EPSILON 1e-6
+#define TOI_MAX_ITERATIONS 64
+#define TOI_CONTACT_STEP 0.05 // fraction of the radii a touching grounded/flying pair may move between checks
+#define HASH_LEVELS 10 // cell sizes HASH_BASE_CELL * 2^level, the last level also takes anything bigger
+#define HASH_BASE_CELL 4
+#define HASH_MIN_BALLS 32 // below this many balls checking every pair is cheaper than building the hash
+#define SCENE_GAP 1 // px kept free between generated balls
+#define SCENE_MAX_ATTEMPTS 30 // spots tried per ball before the generator gives up on it
+#define SCENE_HEX_BAND 2 // radii within this factor of the smallest in their band share one hex lattice
+
+typedef struct Point {
+  double x;
+  double y;
+  struct Point* next;
+  struct Point* prev;
+} Point ;
+
+typedef struct Path {
+  Point* st;
+  Point* top;
+  int n_points;
+} Path;
+
+// BALL->COORDS WILL BE HEAD AND PATH WILL MAKE POINTS TRACING THESE HEAD POINTS TO MAKE PATH LINKED LIST 
+typedef struct Circle {
+  Point* coords;
+  double radius;
+  double xvel;
+  double yvel;
+  uint32_t color;
+  Path* path;
+  int isInteracted;
+  double t; // time at which coords and velocities are valid, only advanced lazily by the event-driven engine
+  int nEvents; // bumped on every event the ball takes part in, invalidates events predicted before it
+  int cellX; // event engine grid cell, only balls in neighbouring cells get predicted against each other
+  int cellY;
+  struct Circle* nextInCell;
+  struct Circle* prevInCell;
+  struct Circle* restingOn; // still ball this one is lying on, rests like a grounded ball until that one moves
+} Circle;
+
+typedef struct WorldParams {
+  double gravity; // px per frame^2 downwards, must not be negative
+  double coeffOfRestitution;
+  double xDampCoeff;
+  double yDampCoeff;
+  double inverseFrictionCoeff;
+  double minXvel;
+  double minYvel;
+} WorldParams;
+
+// One grid of the spatial hash, cells are hashed into a table instead of covering the whole world
+typedef struct HashLevel {
+  double cellSize;
+  double maxRadius;
+  int n;
+  int tableSize; // power of two, about twice the balls in the level
+  int* bucketStart; // tableSize + 1 offsets into entries, counting sort of the level's balls by bucket
+  int* entries; // ball indices
+  int* cellX; // cell of each entry, tells apart different cells that landed in one bucket
+  int* cellY;
+} HashLevel;
+
+// Multi-level spatial hash, every ball sits in the finest level whose cells fit its diameter, so tiny and huge balls both stay a few per cell
+typedef struct SpatialHash {
+  HashLevel levels[HASH_LEVELS];
+  int* ballLevel;
+  int capacity; // balls the arrays are sized for
+} SpatialHash;
+
+// Everything one simulation needs, so any number of them can run side by side
+typedef struct World {
+  WorldParams params;
+  int width;
+  int height;
+  Circle** balls;
+  int n;
+  SpatialHash* hash;
+} World;
+
+typedef enum SceneLayout {
+  SCENE_LINE, // one row across mid height as main2 always did, wrapping into more rows instead of overlapping
+  SCENE_HEX, // hexagonal lattices from the floor up, one per band of similar radii spaced for the band's biggest
+  SCENE_POISSON, // Poisson-disk, blue-noise clusters grown outwards from one seed ball
+  SCENE_RANDOM // uniform random spots, rejecting any that overlap
+} SceneLayout;
+
+typedef enum VelocityDistribution {
+  VELOCITY_ZERO,
+  VELOCITY_UNIFORM, // each component uniform in [-speed, speed]
+  VELOCITY_GAUSSIAN // each component normal with sd speed
+} VelocityDistribution;
+
+typedef struct SceneSpec {
+  SceneLayout layout;
+  int n;
+  double minRadius; // radii are log-uniform between these, equal for a single size, a minimum of 0 or less builds an empty world
+  double maxRadius;
+  uint64_t seed; // same seed, same scene
+  VelocityDistribution velocity;
+  double speed;
+} SceneSpec;
+
+typedef enum EventType {
+  EVENT_WALL_X,
+  EVENT_WALL_Y,
+  EVENT_BALL,
+  EVENT_REST, // rolling ball slows below MIN_ROLLING_XVEL
+  EVENT_CELL // ball moves into another grid cell, meets new neighbours but keeps its trajectory
+} EventType;
+
+typedef struct Event {
+  double t;
+  EventType type;
+  Circle* a;
+  Circle* b;
+  int countA; // a->nEvents when the event was predicted, if the ball took part in anything since, the event is stale
+  int countB;
+} Event;
+
+// Run of touching balls on the floor that end up rolling together after a slow contact
+typedef struct RowBlock {
+  double mass;
+  double xvel;
+  int end; // one past the block's last ball in EventEngine.row
+} RowBlock;
+
+typedef struct EventEngine {
+  Event* heap; // binary min-heap on t, stale events are left in and skipped when popped (lazy invalidation)
+  int n_events;
+  int capacity;
+  double now;
+  World* world;
+  double cellSize; // at least a diameter of the biggest ball, so touching balls are always in neighbouring cells
+  int cols;
+  int rows;
+  Circle** cells; // cols * rows lists linked through nextInCell
+  int stepFrames; // frames left to run with the fixed step after a collapse
+  int backoff; // stepFrames for the next collapse
+  Circle** row; // scratch for settleFloorRow(), left to right
+  RowBlock* blocks;
+} EventEngine;
+
+Point* createPoint(double x, double y);
+Path* createPath(int pathLen, Point* start);
+Circle* createBall(Point* start, double radius, double xvel, double yvel, uint32_t color);
+void nextPointIntoPath(Circle* ball, int maxPoints);
+void nextPointsIntoPaths(Circle** balls, int n, int maxPoints);
+void deletePath(Circle* ball);
+void deleteBall(Circle* ball);
+void deleteBalls(Circle** balls, int n);
+
+WorldParams defaultWorldParams(void);
+void deleteWorld(World* world);
+World* createScene(WorldParams params, int width, int height, SceneSpec* spec);
+double randomUnit(uint64_t* state);
+double randomGaussian(uint64_t* state);
+
+void applyGravity(World* world);
+void reflectionFrictionAndDamping(World* world);
+void collisionTrajectory(World* world, Circle* ball1, Circle* ball2);
+SpatialHash* createSpatialHash(void);
+void deleteSpatialHash(SpatialHash* hash);
+void applyCollisionMechanics(World* world);
+void stepWorld(World* world);
+
+EventEngine* createEventEngine(World* world);
+void advanceEventEngine(EventEngine* engine, double dt);
+void touchBall(EventEngine* engine, Circle* ball);
+void deleteEventEngine(EventEngine* engine);
+
+#endif
@@ -0,0 +1,256 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "physics.h"
+
+#define SWEEP_WIDTH 1920
+#define SWEEP_HEIGHT 1080
+#define SWEEP_WORLDS_PER_SET 64
+#define SWEEP_FRAMES 5000
+#define SWEEP_BALLS 5
+#define SWEEP_DEFAULT_THREADS 4
+#define SWEEP_MAX_INIT_VEL 20
+#define SWEEP_SETTLE_SPEED 0.05 // px/frame, a world is settled once no ball moves faster than this
+#define MAXIMUM_PARAMETER_SETS 4096
+
+// Batch runner for parameter sweeps: every parameter set gets a few worlds with random starting velocities, all worlds are stepped headless on every core and each set is summed up at the end
+
+typedef struct WorldResult {
+  int settleFrame; // first frame all balls were slower than SWEEP_SETTLE_SPEED, -1 if never
+  double finalEnergy; // mean 0.5 * v^2 per ball after the last frame
+  double maxOverlap; // deepest ball-ball penetration after the last frame
+} WorldResult;
+
+// Range of world indices owned by one thread, the owner takes from the front and thieves split off the back half
+typedef struct TaskQueue {
+  int lo;
+  int hi;
+  pthread_mutex_t lock;
+} TaskQueue;
+
+typedef struct Sweep {
+  WorldParams* sets;
+  int n_sets;
+  int worldsPerSet;
+  int frames;
+  int n_balls;
+  int eventDriven;
+  SceneLayout layout;
+  int n_threads;
+  TaskQueue* queues;
+  WorldResult* results;
+} Sweep;
+
+typedef struct Worker {
+  Sweep* sweep;
+  int id;
+} Worker;
+
+int isWorldSettled(World* world) {
+  for (int i = 0; i < world->n; i++) {
+    Circle* ball = world->balls[i];
+    if (ball->xvel * ball->xvel + ball->yvel * ball->yvel > SWEEP_SETTLE_SPEED * SWEEP_SETTLE_SPEED) return 0;
+  }
+  return 1;
+}
+
+void runWorld(Sweep* sweep, int task) {
+  // World k starts from the same scene in every set, so sets differ only in their parameters
+  SceneSpec spec = { sweep->layout, sweep->n_balls, RADIUS, RADIUS, 0x9E3779B97F4A7C15ULL * (uint64_t)(task % sweep->worldsPerSet + 1), VELOCITY_UNIFORM, SWEEP_MAX_INIT_VEL };
+  World* world = createScene(sweep->sets[task / sweep->worldsPerSet], SWEEP_WIDTH, SWEEP_HEIGHT, &spec);
+
+  EventEngine* engine = sweep->eventDriven ? createEventEngine(world) : NULL;
+  WorldResult* result = &sweep->results[task];
+  result->settleFrame = -1;
+
+  for (int frame = 0; frame < sweep->frames; frame++) {
+    if (engine) advanceEventEngine(engine, 1);
+    else stepWorld(world);
+
+    if (result->settleFrame < 0 && isWorldSettled(world)) result->settleFrame = frame;
+  }
+
+  result->finalEnergy = 0;
+  result->maxOverlap = 0;
+  for (int i = 0; i < world->n; i++) {
+    Circle* ball = world->balls[i];
+    result->finalEnergy += 0.5 * (ball->xvel * ball->xvel + ball->yvel * ball->yvel) / world->n;
+
+    for (int j = i + 1; j < world->n; j++) {
+      double dx = world->balls[j]->coords->x - ball->coords->x;
+      double dy = world->balls[j]->coords->y - ball->coords->y;
+      double overlap = ball->radius + world->balls[j]->radius - sqrt(dx * dx + dy * dy);
+      if (overlap > result->maxOverlap) result->maxOverlap = overlap;
+    }
+  }
+
+  if (engine) deleteEventEngine(engine);
+  deleteWorld(world);
+}
+
+// Next world for this thread, stealing half of some other thread's leftovers once its own range runs dry, -1 when everything is taken
+int takeTask(Sweep* sweep, int id) {
+  TaskQueue* own = &sweep->queues[id];
+  int task = -1;
+
+  pthread_mutex_lock(&own->lock);
+  if (own->lo < own->hi) task = own->lo++;
+  pthread_mutex_unlock(&own->lock);
+  if (task >= 0) return task;
+
+  for (int k = 1; k < sweep->n_threads; k++) {
+    TaskQueue* victim = &sweep->queues[(id + k) % sweep->n_threads];
+    int lo = 0, hi = 0;
+
+    pthread_mutex_lock(&victim->lock);
+    int left = victim->hi - victim->lo;
+    if (left > 0) {
+      hi = victim->hi;
+      lo = hi - (left + 1) / 2;
+      victim->hi = lo;
+    }
+    pthread_mutex_unlock(&victim->lock);
+
+    if (lo < hi) { // Never hold two locks at once, so no lock ordering to get wrong
+      pthread_mutex_lock(&own->lock);
+      own->lo = lo + 1;
+      own->hi = hi;
+      pthread_mutex_unlock(&own->lock);
+      return lo;
+    }
+  }
+
+  return -1;
+}
+
+void* workerLoop(void* arg) {
+  Worker* worker = (Worker*)arg;
+  int task;
+  while ((task = takeTask(worker->sweep, worker->id)) >= 0) runWorld(worker->sweep, task);
+  return NULL;
+}
+
+void runSweep(Sweep* sweep) {
+  int n_tasks = sweep->n_sets * sweep->worldsPerSet;
+  sweep->queues = (TaskQueue*)malloc(sweep->n_threads * sizeof(TaskQueue));
+  sweep->results = (WorldResult*)malloc(n_tasks * sizeof(WorldResult));
+
+  // Contiguous chunks to start with, stealing evens out sets that take longer than others
+  for (int i = 0; i < sweep->n_threads; i++) {
+    sweep->queues[i].lo = (int)((long)n_tasks * i / sweep->n_threads);
+    sweep->queues[i].hi = (int)((long)n_tasks * (i + 1) / sweep->n_threads);
+    pthread_mutex_init(&sweep->queues[i].lock, NULL);
+  }
+
+  pthread_t* threads = (pthread_t*)malloc(sweep->n_threads * sizeof(pthread_t));
+  Worker* workers = (Worker*)malloc(sweep->n_threads * sizeof(Worker));
+  for (int i = 0; i < sweep->n_threads; i++) {
+    workers[i].sweep = sweep;
+    workers[i].id = i;
+    pthread_create(&threads[i], NULL, workerLoop, &workers[i]);
+  }
+  for (int i = 0; i < sweep->n_threads; i++) pthread_join(threads[i], NULL);
+
+  for (int i = 0; i < sweep->n_threads; i++) pthread_mutex_destroy(&sweep->queues[i].lock);
+  free(workers);
+  free(threads);
+  free(sweep->queues);
+}
+
+void printSummary(Sweep* sweep) {
+  printf("SET\tGRAVITY\tRESTITUTION\tX_DAMP\tY_DAMP\tFRICTION\tSETTLED\tSETTLE_FRAME(MEAN SD MIN MAX)\tFINAL_KE(MEAN SD)\tMAX_OVERLAP(MEAN MAX)\n");
+
+  for (int s = 0; s < sweep->n_sets; s++) {
+    WorldResult* results = &sweep->results[s * sweep->worldsPerSet];
+    int settled = 0, minFrame = -1, maxFrame = -1;
+    double frameSum = 0, frameSq = 0, energySum = 0, energySq = 0, overlapSum = 0, overlapMax = 0;
+
+    for (int w = 0; w < sweep->worldsPerSet; w++) {
+      if (results[w].settleFrame >= 0) {
+        int f = results[w].settleFrame;
+        settled++;
+        frameSum += f;
+        frameSq += (double)f * f;
+        if (minFrame < 0 || f < minFrame) minFrame = f;
+        if (f > maxFrame) maxFrame = f;
+      }
+      energySum += results[w].finalEnergy;
+      energySq += results[w].finalEnergy * results[w].finalEnergy;
+      overlapSum += results[w].maxOverlap;
+      if (results[w].maxOverlap > overlapMax) overlapMax = results[w].maxOverlap;
+    }
+
+    double frameMean = settled ? frameSum / settled : 0;
+    double frameSd = settled ? sqrt(fmax(0, frameSq / settled - frameMean * frameMean)) : 0;
+    double energyMean = energySum / sweep->worldsPerSet;
+    double energySd = sqrt(fmax(0, energySq / sweep->worldsPerSet - energyMean * energyMean));
+
+    WorldParams* p = &sweep->sets[s];
+    printf("%d\t%g\t%g\t%g\t%g\t%g\t%d/%d\t%.1f %.1f %d %d\t%.4g %.4g\t%.3f %.3f\n", s, p->gravity, p->coeffOfRestitution, p->xDampCoeff, p->yDampCoeff, p->inverseFrictionCoeff, settled, sweep->worldsPerSet, frameMean, frameSd, minFrame, maxFrame, energyMean, energySd, overlapSum / sweep->worldsPerSet, overlapMax);
+  }
+}
+
+// One set per line: GRAVITY COEFF_OF_RESTITUTION X_DAMP_COEFF Y_DAMP_COEFF INVERSE_FRICTION_COEFF, lines starting with # are skipped
+int readParameterSets(FILE* file, WorldParams* sets) {
+  char line[512];
+  int n = 0;
+  while (n < MAXIMUM_PARAMETER_SETS && fgets(line, sizeof(line), file)) {
+    if (line[0] == '#') continue;
+
+    WorldParams params = defaultWorldParams();
+    if (sscanf(line, "%lf %lf %lf %lf %lf", &params.gravity, &params.coeffOfRestitution, &params.xDampCoeff, &params.yDampCoeff, &params.inverseFrictionCoeff) != 5) continue;
+
+    // Balls only ever rest on the floor, upward gravity would leave them stuck to it
+    if (params.gravity < 0) {
+      printf("SKIPPING PARAMETER SET WITH NEGATIVE GRAVITY: %g\n", params.gravity);
+      continue;
+    }
+    sets[n++] = params;
+  }
+  return n;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    printf("USAGE: sweep <parameter file, - for stdin> <(optional) worlds per set> <(optional) frames> <(optional) balls> <(optional) threads> <(optional) 1 for event-driven engine> <(optional) layout 0 line 1 hex 2 poisson 3 random>\n");
+    return 1;
+  }
+
+  FILE* file = argv[1][0] == '-' && !argv[1][1] ? stdin : fopen(argv[1], "r");
+  if (!file) {
+    printf("COULD NOT OPEN PARAMETER FILE: %s\n", argv[1]);
+    return 1;
+  }
+
+  Sweep sweep;
+  sweep.sets = (WorldParams*)malloc(MAXIMUM_PARAMETER_SETS * sizeof(WorldParams));
+  sweep.n_sets = readParameterSets(file, sweep.sets);
+  if (file != stdin) fclose(file);
+
+  sweep.worldsPerSet = argc > 2 && atoi(argv[2]) > 0 ? atoi(argv[2]) : SWEEP_WORLDS_PER_SET;
+  sweep.frames = argc > 3 && atoi(argv[3]) > 0 ? atoi(argv[3]) : SWEEP_FRAMES;
+  sweep.n_balls = argc > 4 && atoi(argv[4]) > 0 ? atoi(argv[4]) : SWEEP_BALLS;
+  sweep.n_threads = argc > 5 && atoi(argv[5]) > 0 ? atoi(argv[5]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (sweep.n_threads <= 0) sweep.n_threads = SWEEP_DEFAULT_THREADS;
+  sweep.eventDriven = argc > 6 && atoi(argv[6]) == 1;
+  sweep.layout = argc > 7 && atoi(argv[7]) >= SCENE_LINE && atoi(argv[7]) <= SCENE_RANDOM ? (SceneLayout)atoi(argv[7]) : SCENE_LINE;
+
+  if (!sweep.n_sets) {
+    printf("NO PARAMETER SETS FOUND, EXPECTED: GRAVITY COEFF_OF_RESTITUTION X_DAMP_COEFF Y_DAMP_COEFF INVERSE_FRICTION_COEFF PER LINE\n");
+    free(sweep.sets);
+    return 1;
+  }
+
+  runSweep(&sweep);
+  printSummary(&sweep);
+
+  free(sweep.results);
+  free(sweep.sets);
+  return 0;
+}
+
+// COMPILE: gcc -O2 -o sweep sweep.c physics.c -lm -lpthread
+// RUN: sweep <parameter file, - for stdin> <(optional) worlds per set> <(optional) frames> <(optional) balls> <(optional) threads> <(optional) 1 for event-driven engine> <(optional) layout 0 line 1 hex 2 poisson 3 random>